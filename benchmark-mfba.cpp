@@ -0,0 +1,197 @@
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "mimetrik/FacebowFileReader.hpp"
+#include "mimetrik/FrameBufferPool.hpp"
+#include "mimetrik/IOPolicy.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
+// Usage: benchmark-mfba [--threads N] [--frame-pool] [--statistics] [--thumbnails] [--io-policy standard|sequential|random|direct|all] <file.mfba> [...]
+// Reads every frame of each file with a cold page cache, once sequentially and once in parallel, and reports the effective
+// frame rate. Pass a 1.0.0 file and its 1.1.0 transcode (see transcode-mfba) to compare the raw and the compressed format.
+// --frame-pool decodes into recycled buffers from FrameBufferPool instead of fresh allocations.
+// --io-policy repeats the passes with the given reader I/O policy (default: standard), and reports how much of the file is
+// left in the page cache afterwards, i.e. how much of the host's working set the pass displaced.
+// --statistics adds a pass that only computes FrameStatistics, without creating any images.
+// --thumbnails writes the thumbnail sidecar if it does not exist yet, then times serving every thumbnail from it, which
+// should take well under 1 ms each.
+
+namespace {
+
+// Ask the kernel to drop the file's clean pages from the page cache, so the next read comes from disk.
+// Not available on Windows or macOS, where the numbers will be warm-cache numbers unless the cache is flushed externally.
+bool evict_from_page_cache([[maybe_unused]] const std::filesystem::path& filepath)
+{
+#ifdef POSIX_FADV_DONTNEED
+	const int fd = ::open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return false;
+	::fdatasync(fd);
+	const bool evicted = ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED) == 0;
+	::close(fd);
+	return evicted;
+#else
+	return false;
+#endif
+}
+
+// Return how many bytes of the file are resident in the page cache, or -1 if this cannot be determined.
+long long resident_bytes(const std::filesystem::path& filepath)
+{
+#ifndef _WIN32
+	const int fd = ::open(filepath.c_str(), O_RDONLY);
+	if (fd < 0)
+		return -1;
+	const auto size = static_cast<std::size_t>(std::filesystem::file_size(filepath));
+	void* mapping = size > 0 ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0) : MAP_FAILED;
+	::close(fd);
+	if (mapping == MAP_FAILED)
+		return -1;
+	const std::size_t page_size = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+	std::vector<unsigned char> pages((size + page_size - 1) / page_size);
+	long long resident = -1;
+	if (::mincore(mapping, size, pages.data()) == 0)
+	{
+		resident = 0;
+		for (const auto page : pages)
+			resident += (page & 1) ? page_size : 0;
+	}
+	::munmap(mapping, size);
+	return std::min<long long>(resident, static_cast<long long>(size));
+#else
+	return -1;
+#endif
+}
+
+template <typename F>
+double time_seconds(F&& f)
+{
+	const auto start = std::chrono::steady_clock::now();
+	f();
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const std::string& label, std::size_t num_frames, std::uintmax_t file_bytes, double seconds, bool cold, long long cached_bytes)
+{
+	std::cout << "  " << std::left << std::setw(24) << label << std::right << std::fixed << std::setprecision(1)
+	          << std::setw(8) << num_frames / seconds << " frames/s"
+	          << std::setw(10) << file_bytes / seconds / (1024.0 * 1024.0) << " MiB/s from disk";
+	if (cached_bytes >= 0)
+		std::cout << std::setw(10) << cached_bytes / (1024.0 * 1024.0) << " MiB left in page cache";
+	std::cout << (cold ? "" : "  (warm cache)") << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	std::size_t num_threads = std::thread::hardware_concurrency();
+	bool use_frame_pool = false;
+	bool benchmark_statistics = false;
+	bool benchmark_thumbnails = false;
+	std::vector<mimetrik::IOPolicy> policies;
+	std::vector<std::filesystem::path> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--threads" && i + 1 < argc)
+			num_threads = std::stoul(argv[++i]);
+		else if (arg == "--frame-pool")
+			use_frame_pool = true;
+		else if (arg == "--statistics")
+			benchmark_statistics = true;
+		else if (arg == "--thumbnails")
+			benchmark_thumbnails = true;
+		else if (arg == "--io-policy" && i + 1 < argc)
+		{
+			const std::string name = argv[++i];
+			if (name == "all")
+				policies = { mimetrik::IOPolicy::standard, mimetrik::IOPolicy::sequential, mimetrik::IOPolicy::random, mimetrik::IOPolicy::direct };
+			else
+				policies.push_back(mimetrik::parse_io_policy(name));
+		}
+		else
+			files.emplace_back(arg);
+	}
+	if (files.empty())
+	{
+		std::cerr << "Usage: " << argv[0] << " [--threads N] [--frame-pool] [--statistics] [--thumbnails] [--io-policy standard|sequential|random|direct|all] <file.mfba> [<file.mfba> ...]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	if (policies.empty())
+		policies.push_back(mimetrik::IOPolicy::standard);
+
+	mimetrik::ThreadPool pool(num_threads);
+
+	for (const auto& file : files)
+	{
+		mimetrik::FacebowFileReader reader(file);
+		if (use_frame_pool)
+			reader.set_mat_allocator(&mimetrik::FrameBufferPool::get_shared());
+		const std::size_t num_frames = reader.get_image_count();
+		const auto file_bytes = std::filesystem::file_size(file);
+		std::vector<std::size_t> indices(num_frames);
+		std::iota(indices.begin(), indices.end(), 0);
+
+		std::cout << file.string() << ": MFBA " << reader.get_version().to_string() << ", " << num_frames << " frames, " << file_bytes << " bytes" << std::endl;
+
+		for (const auto policy : policies)
+		{
+			reader.set_io_policy(policy);
+			const std::string name = mimetrik::to_string(policy);
+
+			bool cold = evict_from_page_cache(file);
+			const double sequential = time_seconds([&] {
+				for (const auto index : indices)
+					reader.get_image(index);
+			});
+			report(name + ", sequential", num_frames, file_bytes, sequential, cold, resident_bytes(file));
+
+			cold = evict_from_page_cache(file);
+			const double parallel = time_seconds([&] { reader.get_images(indices, pool); });
+			report(name + ", " + std::to_string(pool.get_thread_count()) + " threads", num_frames, file_bytes, parallel, cold, resident_bytes(file));
+
+			if (benchmark_statistics)
+			{
+				cold = evict_from_page_cache(file);
+				const double statistics = time_seconds([&] { reader.get_frame_statistics(indices, pool); });
+				report(name + ", statistics only", num_frames, file_bytes, statistics, cold, resident_bytes(file));
+			}
+		}
+
+		if (benchmark_thumbnails && num_frames > 0)
+		{
+			if (!std::filesystem::exists(mimetrik::get_thumbnail_sidecar_path(file)))
+				reader.write_thumbnails(pool);
+			const std::size_t num_thumbnails = 2 * num_frames;
+			const double thumbnails = time_seconds([&] {
+				for (std::size_t i = 0; i < num_thumbnails; ++i)
+					reader.get_thumbnail(i / 2, i % 2);
+			});
+			std::cout << "  " << std::left << std::setw(24) << "thumbnails" << std::right << std::fixed << std::setprecision(3)
+			          << std::setw(8) << thumbnails / num_thumbnails * 1e3 << " ms per thumbnail" << std::endl;
+		}
+	}
+
+	if (use_frame_pool)
+	{
+		const auto stats = mimetrik::FrameBufferPool::get_shared().get_stats();
+		std::cout << "Frame pool: " << stats.hits << " hits, " << stats.misses << " misses, " << stats.outstanding << " outstanding, " << stats.pooled << " pooled, "
+			<< stats.buffer_footprint << " bytes per buffer" << std::endl;
+	}
+
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#ifndef MIMETRIK_CRC32C_HPP
+#define MIMETRIK_CRC32C_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MIMETRIK_CRC32C_X86 1
+#include <nmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+
+namespace mimetrik {
+
+namespace detail {
+
+// Reflected CRC-32C (Castagnoli) polynomial, the one implemented by the SSE4.2 crc32 instruction.
+inline constexpr std::uint32_t crc32c_polynomial = 0x82F63B78u;
+
+inline constexpr std::array<std::uint32_t, 256> make_crc32c_table()
+{
+    std::array<std::uint32_t, 256> table{};
+    for (std::uint32_t i = 0; i < 256; ++i)
+    {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit)
+            crc = (crc >> 1) ^ ((crc & 1u) ? crc32c_polynomial : 0u);
+        table[i] = crc;
+    }
+    return table;
+};
+
+inline constexpr std::array<std::uint32_t, 256> crc32c_table = make_crc32c_table();
+
+/* Table-driven fallback for CPUs without a CRC32C instruction. Operates on the inverted register value.
+ */
+inline std::uint32_t crc32c_software(std::uint32_t crc, const std::byte* data, std::size_t size)
+{
+    for (std::size_t i = 0; i < size; ++i)
+        crc = (crc >> 8) ^ crc32c_table[(crc ^ static_cast<std::uint32_t>(data[i])) & 0xFFu];
+    return crc;
+};
+
+#ifdef MIMETRIK_CRC32C_X86
+/* SSE4.2 implementation, 8 bytes per instruction. Operates on the inverted register value.
+ */
+#if defined(__GNUC__) || defined(__clang__)
+__attribute__((target("sse4.2")))
+#endif
+inline std::uint32_t crc32c_sse42(std::uint32_t crc, const std::byte* data, std::size_t size)
+{
+    std::uint64_t crc64 = crc;
+    while (size >= 8)
+    {
+        std::uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+        crc64 = _mm_crc32_u64(crc64, word);
+        data += 8;
+        size -= 8;
+    }
+    crc = static_cast<std::uint32_t>(crc64);
+    while (size > 0)
+    {
+        crc = _mm_crc32_u8(crc, static_cast<std::uint8_t>(*data));
+        ++data;
+        --size;
+    }
+    return crc;
+};
+
+inline bool cpu_supports_sse42()
+{
+#ifdef _MSC_VER
+    int cpu_info[4];
+    __cpuid(cpu_info, 1);
+    return (cpu_info[2] >> 20) & 1;
+#else
+    return __builtin_cpu_supports("sse4.2");
+#endif
+};
+#endif
+
+} // namespace detail
+
+
+/* Return whether crc32c() uses the SSE4.2 crc32 instruction on this machine (rather than the table-driven fallback).
+ */
+inline bool crc32c_is_hardware_accelerated()
+{
+#ifdef MIMETRIK_CRC32C_X86
+    static const bool has_sse42 = detail::cpu_supports_sse42();
+    return has_sse42;
+#else
+    return false;
+#endif
+};
+
+
+/* Extend the CRC-32C checksum \p crc of some preceding data with \p size more bytes.
+ *
+ * Pass 0 as \p crc for the first block, so crc32c(0, data, size) is the checksum of a single buffer and checksums of
+ * large blocks can be computed chunk by chunk.
+ *
+ * @param[in] crc The checksum of the data so far.
+ * @param[in] data The next bytes.
+ * @param[in] size The number of bytes.
+ * @return The checksum of the data so far followed by \p data.
+ */
+inline std::uint32_t crc32c(std::uint32_t crc, const std::byte* data, std::size_t size)
+{
+    crc = ~crc;
+#ifdef MIMETRIK_CRC32C_X86
+    if (crc32c_is_hardware_accelerated())
+        return ~detail::crc32c_sse42(crc, data, size);
+#endif
+    return ~detail::crc32c_software(crc, data, size);
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_CRC32C_HPP */
@@ -7,15 +7,39 @@
 #include <fstream>
 #include <vector>
 #include <algorithm>
+#include <array>
 #include <optional>
 #include <cstdint>
 #include <map>
 #include <string>
+#include <cstring>
+#include <charconv>
+#include <cmath>
+#include <expected>
+#include <limits>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <span>
+#include <type_traits>
 
 #include "nlohmann/json.hpp"
 #include "opencv2/core.hpp"
 #include "opencv2/imgcodecs.hpp"
 
+#include "mimetrik/FrameStatistics.hpp"
+#include "mimetrik/IOPolicy.hpp"
+#include "mimetrik/MappedFile.hpp"
+#include "mimetrik/MappedImage.hpp"
+#ifndef MIMETRIK_NO_ZSTD
+#include "mimetrik/MFBACompression.hpp"
+#endif
+#include "mimetrik/MFBAHotLayout.hpp"
+#include "mimetrik/MFBAThumbnails.hpp"
+#include "mimetrik/SharedFrameCache.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
 
 namespace mimetrik {
 
@@ -31,6 +55,49 @@ struct MFBAVersion {
     bool operator!=(const MFBAVersion& other) const {
         return !(*this == other);
     };
+
+    std::string to_string() const {
+        return std::to_string(major) + "." + std::to_string(minor) + "." + std::to_string(patch);
+    };
+};
+
+// 1.0.0 stores every image block raw. 1.1.0 has the same layout, but each image block is an independent zstd frame (see MFBACompression.hpp).
+// 1.2.0 is the page-aligned "hot" repack layout that is read through a memory mapping (see MFBAHotLayout.hpp).
+inline constexpr MFBAVersion mfba_version_raw{ 1, 0, 0 };
+inline constexpr MFBAVersion mfba_version_compressed{ 1, 1, 0 };
+inline constexpr MFBAVersion mfba_version_hot{ 1, 2, 0 };
+
+
+// The versions FacebowFileReader can read, oldest first. Builds with MIMETRIK_NO_ZSTD defined (see the MIMETRIK_WITH_ZSTD
+// CMake option) do not depend on zstd and cannot read 1.1.0 files.
+#ifndef MIMETRIK_NO_ZSTD
+inline constexpr std::array<MFBAVersion, 3> supported_mfba_versions = { mfba_version_raw, mfba_version_compressed, mfba_version_hot };
+#else
+inline constexpr std::array<MFBAVersion, 2> supported_mfba_versions = { mfba_version_raw, mfba_version_hot };
+#endif
+
+
+/* Return whether FacebowFileReader can read files of the given MFBA version.
+ */
+inline bool is_supported_mfba_version(const MFBAVersion& version)
+{
+    return std::find(supported_mfba_versions.begin(), supported_mfba_versions.end(), version) != supported_mfba_versions.end();
+};
+
+
+/* Return the error message for files that is_supported_mfba_version() rejects, e.g. "MFBA version is not 1.0.0, 1.1.0 or
+ * 1.2.0". Everything that checks versions reports them with this message, so it always lists what is actually supported.
+ */
+inline std::string get_unsupported_mfba_version_message()
+{
+    std::string message = "MFBA version is not ";
+    for (std::size_t i = 0; i < supported_mfba_versions.size(); ++i)
+    {
+        if (i > 0)
+            message += i + 1 == supported_mfba_versions.size() ? " or " : ", ";
+        message += supported_mfba_versions[i].to_string();
+    }
+    return message;
 };
 
 
@@ -48,6 +115,21 @@ inline bool is_little_endian()
 };
 
 
+/* Decode an unsigned big endian integer (the byte order used throughout the MFBA format) from \p bytes.
+ *
+ * @param[in] bytes Pointer to at least sizeof(T) bytes.
+ * @return The decoded value in native byte order.
+ */
+template <typename T>
+inline T from_big_endian(const std::byte* bytes)
+{
+    T value = 0;
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        value = static_cast<T>((value << 8) | static_cast<T>(bytes[i]));
+    return value;
+};
+
+
 /* Read \p num_bytes bytes from the given file starting at \p start_byte and return them.
  *
  * @param[in] mfba_file The path to the file.
@@ -84,6 +166,26 @@ inline std::vector<std::byte> read_bytes_from_file(const std::filesystem::path&
 };
 
 
+/* Validate an already-read MFBA file header and return the version if it is valid.
+ *
+ * @param[in] header_bytes At least the first 6 bytes of the MFBA file (3 signature bytes followed by 3 version bytes).
+ * @return A pair of a bool indicating whether the header is valid and the version if it is valid.
+ */
+inline std::pair<bool, std::optional<MFBAVersion>> validate_mfba_header(const std::vector<std::byte>& header_bytes) {
+    const std::vector<std::byte> expected_signature = { std::byte('F'), std::byte('F'), std::byte('F') };
+    if (header_bytes.size() < 6 || !std::equal(expected_signature.begin(), expected_signature.end(), header_bytes.begin()))
+        return { false, std::nullopt };
+
+    static_assert(sizeof(std::uint8_t) == sizeof(std::byte));
+    MFBAVersion mfba_version{
+        static_cast<std::uint8_t>(header_bytes[3]),
+        static_cast<std::uint8_t>(header_bytes[4]),
+        static_cast<std::uint8_t>(header_bytes[5])
+    };
+    return { true, mfba_version };
+};
+
+
 /* Validate the MFBA file header and return the version if it is valid.
  *
  * @param[in] mfba_file The path to the MFBA file.
@@ -91,18 +193,232 @@ inline std::vector<std::byte> read_bytes_from_file(const std::filesystem::path&
  */
 inline std::pair<bool, std::optional<MFBAVersion>> validate_mfba_header(const std::filesystem::path& mfba_file) {
     std::vector<std::byte> expected_signature = { std::byte('F'), std::byte('F'), std::byte('F') };
-    const auto file_signature = read_bytes_from_file(mfba_file, 0, 3);
-    if (file_signature != expected_signature)
+    auto header_bytes = read_bytes_from_file(mfba_file, 0, 3);
+    if (header_bytes != expected_signature)
         return { false, std::nullopt };
 
     const auto mfba_version_bytes = read_bytes_from_file(mfba_file, 3, 3);
-    static_assert(sizeof(std::uint8_t) == sizeof(std::byte));
-    MFBAVersion mfba_version{
-        static_cast<std::uint8_t>(mfba_version_bytes[0]),
-        static_cast<std::uint8_t>(mfba_version_bytes[1]),
-        static_cast<std::uint8_t>(mfba_version_bytes[2])
+    header_bytes.insert(header_bytes.end(), mfba_version_bytes.begin(), mfba_version_bytes.end());
+    return validate_mfba_header(header_bytes);
+};
+
+
+/* Stores the fixed-size header at the start of every MFBA file.
+ */
+struct MFBAHeader {
+    MFBAVersion version;
+    std::size_t num_frames;
+};
+
+// 3 signature bytes + 3 version bytes + 2 bytes for num_frames:
+inline constexpr std::size_t mfba_header_size = 8;
+
+
+/* Parse the 8-byte MFBA file header (signature, version and frame count) from \p header_bytes.
+ *
+ * @param[in] header_bytes The first mfba_header_size bytes of the MFBA file.
+ * @return The parsed header, or std::nullopt if the signature is invalid.
+ */
+inline std::optional<MFBAHeader> parse_mfba_header(const std::vector<std::byte>& header_bytes) {
+    if (header_bytes.size() < mfba_header_size)
+        return std::nullopt;
+    const auto [is_valid, mfba_version] = validate_mfba_header(header_bytes);
+    if (!is_valid)
+        return std::nullopt;
+    return MFBAHeader{ mfba_version.value(), from_big_endian<std::uint16_t>(header_bytes.data() + 6) };
+};
+
+
+/* A frame index is a host-local cache of the frame table of a 1.0.0 or 1.1.0 file, written by
+ * FacebowFileReader::write_frame_index(). Readers constructed from a (memory mapped) frame index skip the sweep over all
+ * frame headers, and readers in different processes share the index's pages instead of each holding a copy.
+ *
+ * Layout, in native byte order:
+ *   bytes 0-7    frame_index_magic
+ *   bytes 8-11   frame_index_byte_order_mark, to reject an index written on a host of different endianness
+ *   bytes 12-15  size of a frame table entry (sizeof(FacebowFileReader::FrameLocationInfo))
+ *   bytes 16-23  size of the MFBA file
+ *   bytes 24-31  last write time of the MFBA file, in file clock ticks
+ *   bytes 32-39  number of frames
+ *   bytes 40-42  MFBA version
+ *   bytes 64-    the frame table, one FacebowFileReader::FrameLocationInfo per frame
+ */
+inline constexpr char frame_index_magic[8] = { 'M', 'F', 'B', 'A', 'I', 'D', 'X', '1' };
+inline constexpr std::uint32_t frame_index_byte_order_mark = 0x01020304;
+inline constexpr std::size_t frame_index_header_size = 64;
+
+/* Return the default path of the frame index of \p mfba_file: "<mfba_file>.index".
+ */
+inline std::filesystem::path get_frame_index_path(const std::filesystem::path& mfba_file)
+{
+    auto index_file = mfba_file;
+    index_file += ".index";
+    return index_file;
+};
+
+
+/* How FacebowFileReader::open() treats a file whose frame table is damaged.
+ */
+enum class MFBAOpenMode {
+    // Fail on the first bad frame, like the constructor.
+    strict,
+    // Index every complete frame before the first bad one, e.g. to salvage a truncated upload. The reader's
+    // get_open_error() then describes why the remaining frames were dropped.
+    partial,
+};
+
+
+enum class MFBAOpenErrorCode {
+    io_error,            // The file could not be opened or read.
+    invalid_header,      // Not an MFBA file.
+    unsupported_version,
+    truncated,           // A frame extends past the end of the file.
+    corrupt_frame,       // A frame header holds offsets or sizes the format does not allow.
+    invalid_hot_layout,  // The footer or frame table of a 1.2.0 file is damaged.
+};
+
+
+inline std::string to_string(MFBAOpenErrorCode code)
+{
+    switch (code)
+    {
+    case MFBAOpenErrorCode::io_error: return "io_error";
+    case MFBAOpenErrorCode::invalid_header: return "invalid_header";
+    case MFBAOpenErrorCode::unsupported_version: return "unsupported_version";
+    case MFBAOpenErrorCode::truncated: return "truncated";
+    case MFBAOpenErrorCode::corrupt_frame: return "corrupt_frame";
+    case MFBAOpenErrorCode::invalid_hot_layout: return "invalid_hot_layout";
+    }
+    return "unknown";
+};
+
+
+/* Why an MFBA file, or the part of it past the first bad frame, cannot be read. Returned by FacebowFileReader::open().
+ */
+struct MFBAOpenError {
+    MFBAOpenErrorCode code;
+    std::string reason;
+    std::optional<std::size_t> first_bad_frame; // Unset for problems with the file as a whole, e.g. its header.
+    std::size_t byte_offset = 0; // Where the first bad frame starts.
+    std::size_t num_frames = 0; // As announced by the file header.
+    std::size_t num_recoverable_frames = 0; // The complete frames before the first bad one, which MFBAOpenMode::partial indexes.
+
+    /* Return "frame <first_bad_frame> at byte <byte_offset>: <reason>", or just the reason for problems with the whole file.
+     */
+    std::string to_string() const {
+        if (!first_bad_frame)
+            return reason;
+        return "frame " + std::to_string(first_bad_frame.value()) + " at byte " + std::to_string(byte_offset) + ": " + reason;
+    };
+};
+
+
+/* A bounded, thread-safe cache of open file handles.
+ *
+ * Readers that share a FileHandleCache never hold more than max_open_files descriptors open between them, no matter how many
+ * files they read from. The least recently used handle is closed when the limit is reached. Reads on the same file are
+ * serialised, reads on different files can run concurrently.
+ */
+class FileHandleCache {
+
+public:
+    explicit FileHandleCache(std::size_t max_open_files = 64) : max_open_files(std::max<std::size_t>(max_open_files, 1)) {};
+
+    /* Read \p num_bytes bytes from the given file starting at \p start_byte and return them.
+     *
+     * Performs the same sanity checks, and throws the same errors, as read_bytes_from_file().
+     *
+     * @param[in] filepath The path to the file.
+     * @param[in] start_byte The byte to start reading from.
+     * @param[in] num_bytes The number of bytes to read.
+     * @return A vector of bytes.
+     */
+    std::vector<std::byte> read(const std::filesystem::path& filepath, std::size_t start_byte, std::size_t num_bytes) {
+        const auto handle = acquire(filepath);
+        std::lock_guard<std::mutex> handle_lock(handle->mutex);
+
+        if (handle->size == 0) // avoid undefined behavior
+            throw std::runtime_error(filepath.string() + ": size == 0");
+        if (start_byte > handle->size)
+            throw std::runtime_error(filepath.string() + ": start_byte > size");
+        if (start_byte + num_bytes > handle->size)
+            throw std::runtime_error(filepath.string() + ": end_byte > size");
+
+        std::vector<std::byte> buffer(num_bytes);
+
+        handle->stream.clear();
+        handle->stream.seekg(start_byte, std::ios::beg);
+        if (!handle->stream.read((char*)buffer.data(), num_bytes))
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+
+        return buffer;
+    };
+
+    /* Call \p function with the cached stream of \p filepath and the file size while holding the handle, e.g. to issue many
+     * small reads without the per-read checks and allocations of read().
+     *
+     * @return What \p function returns.
+     */
+    template <typename Function>
+    auto with_stream(const std::filesystem::path& filepath, Function&& function) {
+        const auto handle = acquire(filepath);
+        std::lock_guard<std::mutex> handle_lock(handle->mutex);
+        handle->stream.clear();
+        return function(static_cast<std::istream&>(handle->stream), handle->size);
+    };
+
+    /* Return the number of files that currently have an open handle in the cache.
+     */
+    std::size_t get_open_file_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return handles.size();
+    };
+
+    std::size_t get_max_open_files() const {
+        return max_open_files;
+    };
+
+private:
+    struct Handle {
+        std::ifstream stream;
+        std::size_t size = 0;
+        std::mutex mutex;
+    };
+
+    std::size_t max_open_files;
+    mutable std::mutex mutex;
+    std::list<std::filesystem::path> recently_used; // Most recently used at the front.
+    std::map<std::filesystem::path, std::pair<std::shared_ptr<Handle>, std::list<std::filesystem::path>::iterator>> handles;
+
+    /* Return the open handle for \p filepath, opening it (and closing the least recently used one if needed) first.
+     *
+     * Evicted handles stay alive until any read in progress on them has finished, since readers hold a shared_ptr.
+     */
+    std::shared_ptr<Handle> acquire(const std::filesystem::path& filepath) {
+        std::lock_guard<std::mutex> lock(mutex);
+
+        const auto it = handles.find(filepath);
+        if (it != handles.end())
+        {
+            recently_used.splice(recently_used.begin(), recently_used, it->second.second);
+            return it->second.first;
+        }
+
+        auto handle = std::make_shared<Handle>();
+        handle->stream.open(filepath, std::ios::binary | std::ios::ate);
+        if (!handle->stream)
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+        handle->size = static_cast<std::size_t>(handle->stream.tellg());
+
+        if (handles.size() >= max_open_files)
+        {
+            handles.erase(recently_used.back());
+            recently_used.pop_back();
+        }
+        recently_used.push_front(filepath);
+        handles.emplace(filepath, std::make_pair(handle, recently_used.begin()));
+        return handle;
     };
-    return { true, mfba_version };
 };
 
 
@@ -112,51 +428,137 @@ public:
     /* Construct a FacebowFileReader object for the given MFBA file.
      *
      */
-    FacebowFileReader(const std::filesystem::path& filepath) : filepath(filepath) {
+    FacebowFileReader(const std::filesystem::path& filepath) : FacebowFileReader(filepath, nullptr) {};
+
+    /* Construct a FacebowFileReader object for the given MFBA file that reads through a (possibly shared) file handle cache.
+     *
+     * @param[in] filepath The path to the MFBA file.
+     * @param[in] file_handles The cache to read through. If nullptr, every read opens the file anew.
+     * @param[in] frame_index_file A mapped frame index of the file (see write_frame_index()) to take the frame table from,
+     *                        instead of reading every frame header. Throws if the index does not match the file.
+     */
+    FacebowFileReader(const std::filesystem::path& filepath, std::shared_ptr<FileHandleCache> file_handles,
+        std::shared_ptr<const MappedFile> frame_index_file = nullptr) : filepath(filepath), file_handles(std::move(file_handles)) {
 
         if (!std::filesystem::exists(filepath))
             throw std::runtime_error(filepath.string() + ": file does not exist");
 
 		// Check that the file has a valid header (the first 3 bytes should be "FFF"), and read the version (the next 3 bytes):
-		const auto [is_valid, mfba_version] = validate_mfba_header(filepath);
+		const auto [is_valid, mfba_version] = this->file_handles ? validate_mfba_header(read_bytes(0, mfba_header_size)) : validate_mfba_header(filepath);
 		if (!is_valid)
 			throw std::runtime_error(filepath.string() + ": invalid MFBA header");
-        if (mfba_version.value() != MFBAVersion{ 1, 0, 0 })
+        if (!is_supported_mfba_version(mfba_version.value()))
         {
-            throw std::runtime_error(filepath.string() + ": MFBA version is not 1.0.0");
+            throw std::runtime_error(filepath.string() + ": " + get_unsupported_mfba_version_message());
         }
 		this->mfba_version = mfba_version.value();
 
         this->num_frames = read_image_count();
 
-        // Now sweep through the file and read all header, offset and image size information:
-        std::size_t frame_index = initial_frame_index;
-        for (std::size_t i = 0; i < num_frames; ++i)
+        if (this->mfba_version == mfba_version_hot)
+        {
+            if (const auto error = load_hot_layout(std::make_shared<const MappedFile>(filepath, true)))
+                throw std::runtime_error(filepath.string() + ": " + error.value());
+            return;
+        }
+
+        if (frame_index_file)
         {
-            // Read the offset to the header ("Number of bytes from start of frame"):
-            auto offset_to_header_bytes = read_bytes_from_file(filepath, frame_index, 4);
-            if (is_little_endian())
-                std::reverse(offset_to_header_bytes.begin(), offset_to_header_bytes.end());
-            const std::uint32_t offset_to_header = *reinterpret_cast<const std::uint32_t*>(offset_to_header_bytes.data());
-            
-            // Read the offset to the image information ("Number of bytes from start of frame"):
-            auto offset_to_image_bytes = read_bytes_from_file(filepath, frame_index + 4, 4);
-            if (is_little_endian())
-                std::reverse(offset_to_image_bytes.begin(), offset_to_image_bytes.end());
-            const std::uint32_t offset_to_image = *reinterpret_cast<const std::uint32_t*>(offset_to_image_bytes.data());
-
-            // Read the image size ("Size of this frame and json info (to get to next frame)"):
-            auto image_size_bytes = read_bytes_from_file(filepath, frame_index + 8, 4);
-            if (is_little_endian())
-                std::reverse(image_size_bytes.begin(), image_size_bytes.end());
-            const std::uint32_t image_size = *reinterpret_cast<const std::uint32_t*>(image_size_bytes.data());
-
-            frame_location_info.emplace_back(FrameLocationInfo{ frame_index, offset_to_header, offset_to_image, image_size });
-
-            frame_index += offset_to_header + offset_to_image + image_size;
+            load_frame_index(std::move(frame_index_file));
+            return;
         }
+
+        // Now sweep through the file and read all header, offset and image size information through a single file handle.
+        // The offsets are checked against the file size here, so that a truncated or corrupt file fails now rather than in
+        // the middle of reading its frames:
+        auto locations = std::make_shared<std::vector<FrameLocationInfo>>();
+        std::optional<MFBAOpenError> error;
+        const auto scan = [&](std::istream& stream, std::size_t file_size) {
+            error = scan_frame_table(stream, file_size, MFBAHeader{ this->mfba_version, num_frames }, *locations);
+        };
+        if (this->file_handles)
+        {
+            this->file_handles->with_stream(filepath, scan);
+        }
+        else
+        {
+            std::ifstream ifs(filepath, std::ios::binary | std::ios::ate);
+            if (!ifs)
+                throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+            scan(ifs, static_cast<std::size_t>(ifs.tellg()));
+        }
+        if (error)
+            throw std::runtime_error(filepath.string() + ": " + error->to_string());
+        frame_location_info = std::shared_ptr<const FrameLocationInfo[]>(locations, locations->data());
 	};
 
+    /* Open \p filepath without throwing on missing, malformed or truncated files, e.g. to triage many uploads in parallel.
+     *
+     * Unlike the constructor, the file header and the frame table are read through a single file handle, and every problem
+     * is returned rather than thrown, so rejecting a file costs no more than accepting it. open() may be called
+     * concurrently for different files, e.g. from ThreadPool::parallel_for(). open() itself only throws std::bad_alloc; a
+     * partially opened reader refuses write_frame_index(), since an index of the recoverable frames would never match the file.
+     *
+     * @param[in] filepath The path to the MFBA file.
+     * @param[in] mode In MFBAOpenMode::partial, a file whose frame table breaks off still opens, with every complete frame
+     *                 before the first bad one; get_open_error() then describes the rest of the file.
+     * @param[in] file_handles The cache to read frames through once the file is open, see the constructor.
+     * @return The reader, or why the file cannot be opened.
+     */
+    static std::expected<FacebowFileReader, MFBAOpenError> open(const std::filesystem::path& filepath, MFBAOpenMode mode = MFBAOpenMode::strict,
+        std::shared_ptr<FileHandleCache> file_handles = nullptr) {
+        const auto file_error = [](MFBAOpenErrorCode code, std::string reason, std::size_t num_frames = 0) {
+            return std::unexpected(MFBAOpenError{ code, std::move(reason), std::nullopt, 0, num_frames, 0 });
+        };
+
+        std::ifstream ifs(filepath, std::ios::binary | std::ios::ate);
+        if (!ifs)
+            return file_error(MFBAOpenErrorCode::io_error, std::strerror(errno));
+        const auto file_size = static_cast<std::size_t>(ifs.tellg());
+        std::vector<std::byte> header_bytes(mfba_header_size);
+        if (file_size < mfba_header_size)
+            return file_error(MFBAOpenErrorCode::invalid_header, "file is " + std::to_string(file_size) + " bytes, too small for the MFBA header");
+        ifs.seekg(0, std::ios::beg);
+        if (!ifs.read(reinterpret_cast<char*>(header_bytes.data()), mfba_header_size))
+            return file_error(MFBAOpenErrorCode::io_error, "cannot read MFBA header");
+        const auto header = parse_mfba_header(header_bytes);
+        if (!header)
+            return file_error(MFBAOpenErrorCode::invalid_header, "invalid MFBA header");
+        if (!is_supported_mfba_version(header->version))
+            return file_error(MFBAOpenErrorCode::unsupported_version, get_unsupported_mfba_version_message() + " (" + header->version.to_string() + ")", header->num_frames);
+
+        FacebowFileReader reader(filepath, std::move(file_handles), header.value());
+        if (header->version == mfba_version_hot)
+        {
+            std::shared_ptr<const MappedFile> mapped_file;
+            try {
+                mapped_file = std::make_shared<const MappedFile>(filepath, true);
+            }
+            catch (const std::runtime_error& e) {
+                return file_error(MFBAOpenErrorCode::io_error, e.what(), header->num_frames);
+            }
+            if (auto error = reader.load_hot_layout(std::move(mapped_file)))
+                return file_error(MFBAOpenErrorCode::invalid_hot_layout, std::move(error.value()), header->num_frames);
+            return reader;
+        }
+
+        auto locations = std::make_shared<std::vector<FrameLocationInfo>>();
+        auto error = scan_frame_table(ifs, file_size, header.value(), *locations);
+        if (error && mode == MFBAOpenMode::strict)
+            return std::unexpected(std::move(error.value()));
+        reader.num_frames = locations->size();
+        reader.frame_location_info = std::shared_ptr<const FrameLocationInfo[]>(locations, locations->data());
+        reader.open_error = std::move(error);
+        return reader;
+    };
+
+    /* For a reader opened with MFBAOpenMode::partial: why the frames past get_image_count() were dropped, or std::nullopt
+     * if the file is complete.
+     */
+    const std::optional<MFBAOpenError>& get_open_error() const {
+        return open_error;
+    };
+
     /* Return the number of images in the MFBA file.
      *
      * @return The number of images in the MFBA file.
@@ -171,11 +573,18 @@ public:
      * @param[in] mfba_file The path to the MFBA file.
      * @param[in] index The index of the metadata to read.
      */
-    std::map<std::string, std::map<std::string, std::string>> get_metadata(std::size_t index) {
+    std::map<std::string, std::map<std::string, std::string>> get_metadata(std::size_t index) const {
         if (index >= num_frames)
 			throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
+
+        if (mapping)
+        {
+            // Hot files store the metadata already parsed into the map below, serialised as CBOR:
+            const auto* metadata_begin = reinterpret_cast<const std::uint8_t*>(mapping->data() + hot_frames[index].metadata_offset);
+            return nlohmann::json::from_cbor(metadata_begin, metadata_begin + hot_frames[index].metadata_size).template get<std::map<std::string, std::map<std::string, std::string>>>();
+        }
         
-        const auto metadata_bytes = read_bytes_from_file(filepath, frame_location_info[index].frame_index + frame_location_info[index].offset_to_header, frame_location_info[index].offset_to_image);
+        const auto metadata_bytes = read_bytes(frame_location_info[index].frame_index + frame_location_info[index].offset_to_header, frame_location_info[index].offset_to_image);
         const auto processed_metadata = XOR(metadata_bytes);
         // Convert the sequence of bytes to ASCII. The C# code uses Encoding.ASCII.GetString. The below approach looks to be good for our use case:
         std::string metadata = "";
@@ -205,62 +614,322 @@ public:
     };
 
     /* Read the image at index \p index from the given MFBA file and return it.
+     *
+     * For hot (1.2.0) files no pixels are copied: the returned image points straight into the reader's copy-on-write mapping
+     * and keeps that mapping alive, even after the reader is gone. Writes to it are seen by every image of the same frame
+     * from this reader, clone() it before modifying it.
      *
      * @param[in] mfba_file The path to the MFBA file.
      * @param[in] index The index of the image to read.
      */
     cv::Mat get_image(std::size_t index) {
+        return load_image(index, nullptr);
+    };
+
+    /* Read the image at index \p index and compute its statistics (see FrameStatistics) in the same pass.
+     *
+     * The statistics are accumulated row by row while the pixels are un-XOR'd into the image, so each row is still in the
+     * CPU cache when they are computed, instead of re-walking the whole image afterwards.
+     *
+     * @param[in] index The index of the image to read.
+     * @param[out] statistics Receives the statistics of the image.
+     */
+    cv::Mat get_image(std::size_t index, FrameStatistics& statistics) {
+        return load_image(index, &statistics);
+    };
+
+    /* Compute the statistics of the image at index \p index without creating a cv::Mat for it: the pixels are un-XOR'd one
+     * row at a time into a small scratch buffer, or, for hot files, read straight from the mapping.
+     *
+     * @param[in] index The index of the image.
+     */
+    FrameStatistics get_frame_statistics(std::size_t index) const {
         if (index >= num_frames)
             throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
 
-        const auto imagedata_bytes = read_bytes_from_file(filepath, frame_location_info[index].frame_index + frame_location_info[index].offset_to_header + frame_location_info[index].offset_to_image, frame_location_info[index].image_size);
-        const auto processed_imagedata = XOR(imagedata_bytes);
+        const auto [rows, cols] = get_frame_shape(index);
+        const std::size_t row_bytes = std::size_t(cols) * 3;
+        FrameStatisticsAccumulator accumulator(cols);
+        if (mapping)
+        {
+            const auto* pixels = reinterpret_cast<const std::uint8_t*>(mapping->data() + hot_frames[index].pixel_offset);
+            for (int row = 0; row < rows; ++row)
+                accumulator.add_row(pixels + row * row_bytes);
+            return accumulator.finish();
+        }
 
-		// We need the metadata to know the orientation. Not ideal, but we'll work with it for now. EG are currently not storing the width and height correctly for landscape images, thus we need the if/else below.
-		const auto exif_orientation_value = std::stoi(get_metadata(index).at("Orientation").at("Orientation"));
+        const auto imagedata_bytes = read_image_block(index);
+        std::vector<std::uint8_t> row_buffer(row_bytes);
+        for (int row = 0; row < rows; ++row)
+        {
+            unxor_bytes(imagedata_bytes.data() + row * row_bytes, row_buffer.data(), row_bytes);
+            accumulator.add_row(row_buffer.data());
+        }
+        return accumulator.finish();
+    };
 
-		cv::Mat image;
-		// See the different orientation values here: https://developer.android.com/reference/android/media/ExifInterface
-        // 6: ORIENTATION_ROTATE_90: Normal, upright portrait image
-        // 7: ORIENTATION_TRANSVERSE: "flipped about top-right <--> bottom-left axis". Portrait. I think this is when the phone is upside down - and it flips the image so the image itself is upright again.
-        // A StackOverflow post said that these values are further documented in Android's source code in android\media\ExifInterface.java.
-        if (exif_orientation_value == 6 || exif_orientation_value == 7)
-		{
-			image = cv::Mat(image_height, image_width, CV_8UC3);
-			std::size_t i = 0;
-			for (int row = 0; row < image_height; ++row)
-			{
-				for (int col = 0; col < image_width; ++col)
-				{
-					// The data is stored in BGR order - since OpenCV uses BGR by default, we don't need to swap the order:
-					image.at<cv::Vec3b>(row, col)[0] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-					image.at<cv::Vec3b>(row, col)[1] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-					image.at<cv::Vec3b>(row, col)[2] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-				}
-			}
-		}
-        // 1: ORIENTATION_NORMAL which means a landscape image - this is the phone rotated to the left.
-        // 3: ORIENTATION_ROTATE_180, which is landscape too - likely the phone rotated to the right.
-        else if (exif_orientation_value == 1 || exif_orientation_value == 3)
-		{
-			// Note w/h are swapped here - image_width is actually the height, image_height is the width. See comment further above about EG's storing of the width/height.
-			image = cv::Mat(image_width, image_height, CV_8UC3);
-			std::size_t i = 0;
-			for (int row = 0; row < image_width; ++row)
-			{
-				for (int col = 0; col < image_height; ++col)
-				{
-					// The data is stored in BGR order - since OpenCV uses BGR by default, we don't need to swap the order:
-					image.at<cv::Vec3b>(row, col)[0] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-					image.at<cv::Vec3b>(row, col)[1] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-					image.at<cv::Vec3b>(row, col)[2] = static_cast<std::uint8_t>(processed_imagedata[i++]);
-				}
-			}
-        } else {
-			throw std::runtime_error("Unsupported orientation value: " + std::to_string(exif_orientation_value));
-		}
+    /* Compute the statistics of the images at the given indices on \p pool, one frame per task, without creating any cv::Mat.
+     *
+     * @param[in] indices The indices of the images.
+     * @param[in] pool The thread pool to compute on.
+     * @return The statistics, in the order of \p indices.
+     */
+    std::vector<FrameStatistics> get_frame_statistics(const std::vector<std::size_t>& indices, ThreadPool& pool) const {
+        std::vector<FrameStatistics> statistics(indices.size());
+        pool.parallel_for(indices.size(), [&](std::size_t i) {
+            statistics[i] = get_frame_statistics(indices[i]);
+        });
+        return statistics;
+    };
 
-        return image;
+    /* Read the images at the given indices and return them. Only the selected frames are decoded.
+     *
+     * Intended to be combined with the temporal queries below, e.g. get_images(sample_frames_at_fps(5.0)).
+     *
+     * @param[in] indices The indices of the images to read.
+     * @return The images, in the order of \p indices.
+     */
+    std::vector<cv::Mat> get_images(const std::vector<std::size_t>& indices) {
+        std::vector<cv::Mat> images;
+        images.reserve(indices.size());
+        for (const auto index : indices)
+            images.push_back(get_image(index));
+        return images;
+    };
+
+    /* Read the images at the given indices on \p pool, one frame per task.
+     *
+     * Reading and, for MFBA 1.1.0 files, decompressing the frames is spread over all workers, which is what makes compressed
+     * captures faster to read than raw ones when I/O is the bottleneck.
+     *
+     * @param[in] indices The indices of the images to read.
+     * @param[in] pool The thread pool to decode on.
+     * @return The images, in the order of \p indices.
+     */
+    std::vector<cv::Mat> get_images(const std::vector<std::size_t>& indices, ThreadPool& pool) {
+        std::vector<cv::Mat> images(indices.size());
+        pool.parallel_for(indices.size(), [&](std::size_t i) {
+            images[i] = get_image(indices[i]);
+        });
+        return images;
+    };
+
+    /* Read the image block of frame \p index as stored in MFBA 1.0.0, i.e. uncompressed but still XOR'd.
+     *
+     * For MFBA 1.1.0 files the block is decompressed first. This is the unit the transcoder works on.
+     *
+     * @param[in] index The index of the frame.
+     * @return The XOR'd BGR bytes of the image.
+     */
+    std::vector<std::byte> read_image_block(std::size_t index) const {
+        if (index >= num_frames)
+            throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
+
+        if (mapping)
+        {
+            const auto* pixels = mapping->data() + hot_frames[index].pixel_offset;
+            return XOR(std::vector<std::byte>(pixels, pixels + static_cast<std::size_t>(hot_frames[index].rows) * hot_frames[index].cols * 3));
+        }
+
+        const auto& location = frame_location_info[index];
+        auto block = read_bytes(location.frame_index + location.offset_to_header + location.offset_to_image, location.image_size);
+#ifndef MIMETRIK_NO_ZSTD
+        if (mfba_version == mfba_version_compressed)
+            block = decompress_image_block(block, expected_image_size);
+#endif
+        return block;
+    };
+
+    /* Read the raw, still XOR'd metadata block of frame \p index.
+     */
+    std::vector<std::byte> read_metadata_block(std::size_t index) const {
+        if (index >= num_frames)
+            throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
+
+        if (mapping)
+        {
+            // Rebuild the array-of-sources JSON of the original format from the parsed metadata:
+            nlohmann::json json_metadata = nlohmann::json::array();
+            for (const auto& [metadata_source, contents] : get_metadata(index))
+            {
+                nlohmann::json json_contents = nlohmann::json::array();
+                for (const auto& [key, value] : contents)
+                    json_contents.push_back({ { "key", key }, { "value", value } });
+                json_metadata.push_back({ { "metadataSource", metadata_source }, { "contents", json_contents } });
+            }
+            const auto metadata = json_metadata.dump();
+            std::vector<std::byte> metadata_bytes(metadata.size());
+            std::transform(metadata.begin(), metadata.end(), metadata_bytes.begin(), [](char c) { return static_cast<std::byte>(c); });
+            return XOR(metadata_bytes);
+        }
+
+        const auto& location = frame_location_info[index];
+        return read_bytes(location.frame_index + location.offset_to_header, location.offset_to_image);
+    };
+
+    /* Set the allocator for the pixel buffers of the images returned by get_image(), e.g. &FrameBufferPool::get_shared().
+     *
+     * The allocator must outlive all images allocated with it. Images of hot files point into the mapping and do not use it.
+     *
+     * @param[in] allocator The allocator to use, or nullptr for OpenCV's default allocator.
+     */
+    void set_mat_allocator(cv::MatAllocator* allocator) {
+        mat_allocator = allocator;
+    };
+
+    /* Share decoded frames with other processes on this host through \p cache: get_image() first looks the frame up there,
+     * and stores what it decodes. Frames are keyed by get_file_fingerprint(), so a rewritten file never hits stale frames.
+     * Hot files are already served from the page cache and do not use it.
+     *
+     * @param[in] cache The shared frame cache, or nullptr to stop using one.
+     */
+    void set_shared_frame_cache(std::shared_ptr<SharedFrameCache> cache) {
+        if (cache)
+            file_fingerprint = get_file_fingerprint(filepath);
+        shared_frame_cache = std::move(cache);
+    };
+
+    /* Set how subsequent reads interact with the page cache, see IOPolicy.
+     *
+     * With any policy other than IOPolicy::standard, the reader keeps its own file descriptor and reads with pread(),
+     * bypassing the file handle cache. Hot files are served from their mapping and ignore the policy.
+     *
+     * @param[in] policy The I/O policy, e.g. IOPolicy::sequential for a one-shot conversion of a large archive.
+     * @param[in] readahead_bytes For IOPolicy::sequential, how far ahead of each read to prefetch.
+     */
+    void set_io_policy(IOPolicy policy, std::size_t readahead_bytes = std::size_t(16) * 1024 * 1024) {
+        if (policy == IOPolicy::standard)
+            policy_file.reset();
+        else
+            policy_file = std::make_shared<PolicyFile>(filepath, policy, readahead_bytes);
+    };
+
+    IOPolicy get_io_policy() const {
+        return policy_file ? policy_file->get_policy() : IOPolicy::standard;
+    };
+
+    /* Return how many reads went back to data that IOPolicy::sequential had already dropped from the page cache (see
+     * PolicyFile::get_reread_count()), or 0 under other policies.
+     */
+    std::size_t get_io_reread_count() const {
+        return policy_file ? policy_file->get_reread_count() : 0;
+    };
+
+    /* Return whether the file uses the hot (1.2.0) layout, i.e. whether get_image() returns zero-copy views of a mapping.
+     */
+    bool is_memory_mapped() const {
+        return mapping != nullptr;
+    };
+
+    MFBAVersion get_version() const {
+        return mfba_version;
+    };
+
+    const std::filesystem::path& get_filepath() const {
+        return filepath;
+    };
+
+    /* Return the sensor timestamp ("android.sensor.timestamp" in the CaptureResult metadata, in nanoseconds) of every frame.
+     *
+     * The timestamps are extracted once, on the first call (or the first temporal query), and cached alongside the frame
+     * location info. Building the index is not thread-safe, so call this once before sharing a reader across threads.
+     *
+     * @return One timestamp per frame, in frame order.
+     */
+    const std::vector<std::int64_t>& get_timestamps() {
+        if (frame_timestamps.size() != num_frames)
+        {
+            std::vector<std::int64_t> timestamps;
+            timestamps.reserve(num_frames);
+            for (std::size_t i = 0; i < num_frames; ++i)
+                timestamps.push_back(read_timestamp(i));
+            frame_timestamps = std::move(timestamps);
+        }
+        return frame_timestamps;
+    };
+
+    /* Return the index of the frame closest to \p time.
+     *
+     * Times are in seconds relative to the first frame's timestamp. Like all temporal queries, this throws if the timestamps
+     * are not in capture (non-decreasing) order, since the queries binary-search them.
+     *
+     * @param[in] time The time in seconds since the first frame.
+     * @return The index of the frame with the nearest timestamp.
+     */
+    std::size_t find_frame_at(double time) {
+        if (num_frames == 0)
+            throw std::runtime_error("Image frame out of range, file includes 0 frames");
+        const auto& timestamps = get_sorted_timestamps();
+        const std::int64_t target = timestamps.front() + seconds_to_nanoseconds(time);
+
+        const auto it = std::lower_bound(timestamps.begin(), timestamps.end(), target);
+        if (it == timestamps.begin())
+            return 0;
+        if (it == timestamps.end())
+            return num_frames - 1;
+        // Pick whichever neighbour is closer, preferring the earlier frame on ties:
+        const auto index = static_cast<std::size_t>(it - timestamps.begin());
+        return (*it - target < target - *(it - 1)) ? index : index - 1;
+    };
+
+    /* Return the indices of all frames with a timestamp in [\p start_time, \p end_time).
+     *
+     * @param[in] start_time The start of the range, in seconds since the first frame (inclusive).
+     * @param[in] end_time The end of the range, in seconds since the first frame (exclusive).
+     * @return The frame indices, in ascending order.
+     */
+    std::vector<std::size_t> find_frames_in_range(double start_time, double end_time) {
+        std::vector<std::size_t> indices;
+        if (num_frames == 0 || end_time <= start_time)
+            return indices;
+        const auto& timestamps = get_sorted_timestamps();
+        const auto first = std::lower_bound(timestamps.begin(), timestamps.end(), timestamps.front() + seconds_to_nanoseconds(start_time));
+        const auto last = std::lower_bound(first, timestamps.end(), timestamps.front() + seconds_to_nanoseconds(end_time));
+        for (auto it = first; it != last; ++it)
+            indices.push_back(static_cast<std::size_t>(it - timestamps.begin()));
+        return indices;
+    };
+
+    /* Return every \p stride-th frame index, starting at \p first_index.
+     *
+     * This does not need the timestamp index.
+     */
+    std::vector<std::size_t> sample_frames_by_stride(std::size_t stride, std::size_t first_index = 0) const {
+        if (stride == 0)
+            throw std::runtime_error("Sampling stride must be at least 1");
+        std::vector<std::size_t> indices;
+        for (std::size_t i = first_index; i < num_frames; i += stride)
+            indices.push_back(i);
+        return indices;
+    };
+
+    /* Return the frame indices that resample the capture to \p target_fps.
+     *
+     * For every tick k / target_fps between the first and the last timestamp, the nearest frame is selected. A frame is
+     * never selected twice, so asking for a rate above the (average) capture rate returns every frame once, without
+     * visiting more ticks than there are frames.
+     *
+     * @param[in] target_fps The desired frame rate in frames per second.
+     * @return The selected frame indices, in ascending order.
+     */
+    std::vector<std::size_t> sample_frames_at_fps(double target_fps) {
+        if (!(target_fps > 0.0) || !std::isfinite(target_fps))
+            throw std::runtime_error("Target frame rate must be positive and finite");
+        std::vector<std::size_t> indices;
+        if (num_frames == 0)
+            return indices;
+        const auto& timestamps = get_sorted_timestamps();
+        const double duration = static_cast<double>(timestamps.back() - timestamps.front()) / 1e9;
+        if (duration * target_fps >= static_cast<double>(num_frames))
+            return sample_frames_by_stride(1);
+        const auto num_ticks = static_cast<std::size_t>(std::floor(duration * target_fps + 1e-9)) + 1;
+        for (std::size_t k = 0; k < num_ticks; ++k)
+        {
+            const auto index = find_frame_at(static_cast<double>(k) / target_fps);
+            if (indices.empty() || indices.back() != index)
+                indices.push_back(index);
+        }
+        return indices;
     };
 
     /* Stores the header information for a frame in the MFBA file.
@@ -272,14 +941,295 @@ public:
         std::uint32_t image_size;
     };
 
+    // The size of a decoded (and, in 1.0.0 files, of a stored) image block: 1080x1920 BGR.
+    static constexpr std::size_t expected_image_size = std::size_t(1080) * 1920 * 3;
+
+    /* Check that the frame described by \p location is structurally sound, without reading any of it.
+     *
+     * @param[in] location The frame's location info as read from its 12-byte frame header.
+     * @param[in] file_size The size of the MFBA file in bytes.
+     * @param[in] version The MFBA version of the file (1.0.0 or 1.1.0).
+     * @return A description of the first problem found, or std::nullopt if the frame is fine.
+     */
+    static std::optional<std::string> check_frame_location(const FrameLocationInfo& location, std::size_t file_size, MFBAVersion version) {
+        if (location.offset_to_header < 12)
+            return "offset to header (" + std::to_string(location.offset_to_header) + ") is smaller than the 12-byte frame header";
+        const std::size_t frame_end = location.frame_index + location.offset_to_header + location.offset_to_image + location.image_size;
+        if (frame_end > file_size)
+            return "frame ends at byte " + std::to_string(frame_end) + ", past the end of the file (" + std::to_string(file_size) + " bytes)";
+        if (version == mfba_version_raw && location.image_size != expected_image_size)
+            return "image size is " + std::to_string(location.image_size) + " bytes, expected " + std::to_string(expected_image_size);
+        if (version == mfba_version_compressed && location.image_size == 0)
+            return "compressed image block is empty";
+        return std::nullopt;
+    };
+
+    /* Read and check the frame table of a 1.0.0 or 1.1.0 file, 12 bytes per frame, through a single stream and without
+     * throwing. Stops at the first bad frame.
+     *
+     * @param[in] stream The MFBA file, opened in binary mode.
+     * @param[in] file_size The size of the MFBA file in bytes.
+     * @param[in] header The parsed file header.
+     * @param[out] locations Receives the location of every frame before the first bad one.
+     * @return The first problem found, or std::nullopt if all frames announced by the header are sound.
+     */
+    static std::optional<MFBAOpenError> scan_frame_table(std::istream& stream, std::size_t file_size, const MFBAHeader& header, std::vector<FrameLocationInfo>& locations) {
+        locations.clear();
+        locations.reserve(header.num_frames);
+        std::size_t frame_index = mfba_header_size;
+        for (std::size_t i = 0; i < header.num_frames; ++i)
+        {
+            const auto fail = [&](MFBAOpenErrorCode code, std::string reason) {
+                return MFBAOpenError{ code, std::move(reason), i, frame_index, header.num_frames, i };
+            };
+
+            if (frame_index + 12 > file_size)
+                return fail(MFBAOpenErrorCode::truncated, "frame header lies past the end of the file (" + std::to_string(file_size) + " bytes)");
+            std::byte frame_header[12];
+            stream.seekg(static_cast<std::streamoff>(frame_index));
+            if (!stream.read(reinterpret_cast<char*>(frame_header), sizeof(frame_header)))
+                return fail(MFBAOpenErrorCode::io_error, "cannot read frame header");
+
+            // The offset to the header, the offset to the image information and the image size, see FrameLocationInfo:
+            const FrameLocationInfo location{
+                frame_index,
+                from_big_endian<std::uint32_t>(frame_header),
+                from_big_endian<std::uint32_t>(frame_header + 4),
+                from_big_endian<std::uint32_t>(frame_header + 8)
+            };
+            if (const auto error = check_frame_location(location, file_size, header.version))
+            {
+                // A frame that would be fine in a longer file was cut off; anything else is corrupt:
+                const bool is_truncated = !check_frame_location(location, std::numeric_limits<std::size_t>::max(), header.version);
+                return fail(is_truncated ? MFBAOpenErrorCode::truncated : MFBAOpenErrorCode::corrupt_frame, error.value());
+            }
+            locations.push_back(location);
+
+            frame_index += std::size_t(location.offset_to_header) + location.offset_to_image + location.image_size;
+        }
+        return std::nullopt;
+    };
+
+    /* Return the frame table of a 1.0.0 or 1.1.0 file, or an empty span for hot files.
+     */
+    std::span<const FrameLocationInfo> get_frame_location_info() const {
+        return { frame_location_info.get(), frame_location_info ? num_frames : 0 };
+    };
+
+    /* Write the frame table to \p index_file, so that other readers of this file, e.g. in worker processes, can be
+     * constructed from it without sweeping the frame headers again. The index is written to a temporary file and renamed
+     * into place, so concurrent readers never see a partial index.
+     *
+     * @param[in] index_file Where to write the frame index, by default get_frame_index_path(filepath).
+     */
+    void write_frame_index(const std::filesystem::path& index_file) const {
+        if (mapping)
+            throw std::runtime_error(filepath.string() + ": hot (1.2.0) files carry their own frame table");
+        if (open_error)
+            throw std::runtime_error(filepath.string() + ": cannot write a frame index of a partially opened file");
+
+        std::vector<std::byte> header(frame_index_header_size);
+        const std::uint32_t entry_size = sizeof(FrameLocationInfo);
+        const std::uint64_t file_size = std::filesystem::file_size(filepath);
+        const std::int64_t write_time = std::filesystem::last_write_time(filepath).time_since_epoch().count();
+        const std::uint64_t frame_count = num_frames;
+        std::memcpy(header.data(), frame_index_magic, sizeof(frame_index_magic));
+        std::memcpy(header.data() + 8, &frame_index_byte_order_mark, 4);
+        std::memcpy(header.data() + 12, &entry_size, 4);
+        std::memcpy(header.data() + 16, &file_size, 8);
+        std::memcpy(header.data() + 24, &write_time, 8);
+        std::memcpy(header.data() + 32, &frame_count, 8);
+        header[40] = std::byte(mfba_version.major);
+        header[41] = std::byte(mfba_version.minor);
+        header[42] = std::byte(mfba_version.patch);
+
+        auto temporary_file = index_file;
+        temporary_file += ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream ofs(temporary_file, std::ios::binary | std::ios::trunc);
+            ofs.write(reinterpret_cast<const char*>(header.data()), header.size());
+            ofs.write(reinterpret_cast<const char*>(frame_location_info.get()), std::streamsize(num_frames * sizeof(FrameLocationInfo)));
+            if (!ofs)
+                throw std::runtime_error(temporary_file.string() + ": write failed");
+        }
+        std::filesystem::rename(temporary_file, index_file);
+    };
+
+    void write_frame_index() const {
+        write_frame_index(get_frame_index_path(filepath));
+    };
+
+    /* Write 1/4 and 1/16 size thumbnails of every frame to a thumbnail sidecar (see MFBAThumbnails.hpp), for
+     * get_thumbnail(). Frames are downscaled in parallel on \p pool, straight from their stored pixel blocks, without
+     * materialising full-size images.
+     *
+     * @param[in] pool The thread pool to downscale frames on.
+     * @param[in] sidecar_file Where to write the sidecar, by default get_thumbnail_sidecar_path(filepath).
+     */
+    void write_thumbnails(ThreadPool& pool, const std::filesystem::path& sidecar_file = {}) const {
+        const auto sidecar_path = sidecar_file.empty() ? get_thumbnail_sidecar_path(filepath) : sidecar_file;
+
+        std::vector<std::pair<int, int>> shapes(num_frames);
+        pool.parallel_for(num_frames, [&](std::size_t i) { shapes[i] = get_frame_shape(i); });
+
+        ThumbnailSidecarHeader header{ std::filesystem::file_size(filepath), std::filesystem::last_write_time(filepath).time_since_epoch().count(),
+            static_cast<std::uint32_t>(num_frames), {}, {} };
+        std::vector<std::byte> frame_table;
+        frame_table.reserve(num_frames * thumbnail_frame_record_size);
+        for (const auto& [rows, cols] : shapes)
+        {
+            for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+                header.slot_sizes[level] = std::max<std::uint32_t>(header.slot_sizes[level], (rows / thumbnail_factors[level]) * (cols / thumbnail_factors[level]) * 3);
+            for (const int value : { rows, cols })
+            {
+                frame_table.push_back(static_cast<std::byte>(value >> 8));
+                frame_table.push_back(static_cast<std::byte>(value & 0xFF));
+            }
+        }
+        std::size_t offset = thumbnail_header_size + frame_table.size();
+        for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+        {
+            header.level_offsets[level] = (offset + thumbnail_block_alignment - 1) / thumbnail_block_alignment * thumbnail_block_alignment;
+            offset = header.level_offsets[level] + std::size_t(header.slot_sizes[level]) * num_frames;
+        }
+
+        auto temporary_file = sidecar_path;
+        temporary_file += ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream ofs(temporary_file, std::ios::binary | std::ios::trunc);
+            const auto header_bytes = encode_thumbnail_sidecar_header(header);
+            ofs.write(reinterpret_cast<const char*>(header_bytes.data()), header_bytes.size());
+            ofs.write(reinterpret_cast<const char*>(frame_table.data()), frame_table.size());
+
+            // Downscale a batch of frames in parallel, then write it out, so memory use stays bounded:
+            const std::size_t batch_size = 4 * pool.get_thread_count();
+            std::vector<std::array<std::vector<std::byte>, thumbnail_factors.size()>> thumbnails(batch_size);
+            for (std::size_t first = 0; first < num_frames; first += batch_size)
+            {
+                const std::size_t count = std::min(batch_size, num_frames - first);
+                pool.parallel_for(count, [&](std::size_t i) {
+                    const std::size_t frame = first + i;
+                    const auto [rows, cols] = shapes[frame];
+                    if (mapping)
+                    {
+                        downscale_frame(mapping->data() + hot_frames[frame].pixel_offset, rows, cols, false, thumbnails[i]);
+                        return;
+                    }
+                    const auto block = read_image_block(frame);
+                    if (block.size() != std::size_t(rows) * cols * 3)
+                        throw std::runtime_error(filepath.string() + ": frame " + std::to_string(frame) + ": image block does not match its orientation");
+                    downscale_frame(block.data(), rows, cols, true, thumbnails[i]);
+                });
+                for (std::size_t i = 0; i < count; ++i)
+                {
+                    for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+                    {
+                        ofs.seekp(header.level_offsets[level] + std::size_t(header.slot_sizes[level]) * (first + i));
+                        ofs.write(reinterpret_cast<const char*>(thumbnails[i][level].data()), thumbnails[i][level].size());
+                    }
+                }
+            }
+            // Extend the file to its full size, in case the last slot is not filled completely:
+            ofs.seekp(offset - 1);
+            ofs.put(0);
+            if (!ofs)
+                throw std::runtime_error(temporary_file.string() + ": write failed");
+        }
+        std::filesystem::rename(temporary_file, sidecar_path);
+    };
+
+    void write_thumbnails() const {
+        ThreadPool pool;
+        write_thumbnails(pool);
+    };
+
+    /* Map the thumbnail sidecar for get_thumbnail(). Throws if it does not exist or was written for another version of the
+     * MFBA file.
+     *
+     * @param[in] sidecar_file The sidecar to use, by default get_thumbnail_sidecar_path(filepath).
+     */
+    void load_thumbnails(const std::filesystem::path& sidecar_file = {}) {
+        const auto sidecar_path = sidecar_file.empty() ? get_thumbnail_sidecar_path(filepath) : sidecar_file;
+        if (!std::filesystem::exists(sidecar_path))
+            throw std::runtime_error(sidecar_path.string() + ": thumbnail sidecar does not exist, create it with write_thumbnails()");
+
+        auto sidecar = std::make_shared<const MappedFile>(sidecar_path, true);
+        const auto header = decode_thumbnail_sidecar_header(sidecar->data(), sidecar->size());
+        const auto is_valid = [&] {
+            if (!header || header->mfba_file_size != std::filesystem::file_size(filepath) || header->num_frames != num_frames
+                || header->mfba_write_time != std::filesystem::last_write_time(filepath).time_since_epoch().count()
+                || thumbnail_header_size + num_frames * thumbnail_frame_record_size > sidecar->size())
+                return false;
+            for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+            {
+                if (header->level_offsets[level] > sidecar->size() || (sidecar->size() - header->level_offsets[level]) / std::max<std::size_t>(header->slot_sizes[level], 1) < num_frames)
+                    return false;
+            }
+            return true;
+        };
+        if (!is_valid())
+            throw std::runtime_error(sidecar_path.string() + ": thumbnail sidecar does not match the file");
+        thumbnail_header = header.value();
+        thumbnails = std::move(sidecar);
+    };
+
+    /* Return the thumbnail of the image at index \p index, as a view of the memory mapped thumbnail sidecar.
+     *
+     * The sidecar must have been written with write_thumbnails(); it is mapped on first use (see load_thumbnails()), which,
+     * like get_timestamps(), must not race with other calls. The returned image keeps the mapping alive, even after the reader
+     * is gone or has loaded another sidecar. The mapping is copy-on-write, so writes to the image never reach the sidecar but
+     * are seen by every later view of the same thumbnail: clone() it before modifying it.
+     *
+     * @param[in] index The index of the image.
+     * @param[in] level 0 for 1/4 of the full size in each dimension, 1 for 1/16.
+     */
+    cv::Mat get_thumbnail(std::size_t index, std::size_t level) {
+        if (index >= num_frames)
+            throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
+        if (level >= thumbnail_factors.size())
+            throw std::runtime_error("Thumbnail level out of range, there are " + std::to_string(thumbnail_factors.size()) + " levels");
+        if (!thumbnails)
+            load_thumbnails();
+
+        const std::byte* frame_record = thumbnails->data() + thumbnail_header_size + index * thumbnail_frame_record_size;
+        const int rows = from_big_endian<std::uint16_t>(frame_record) / thumbnail_factors[level];
+        const int cols = from_big_endian<std::uint16_t>(frame_record + 2) / thumbnail_factors[level];
+        if (std::size_t(rows) * cols * 3 > thumbnail_header.slot_sizes[level])
+            throw std::runtime_error(filepath.string() + ": frame " + std::to_string(index) + ": thumbnail is larger than its slot");
+        const std::byte* pixels = thumbnails->data() + thumbnail_header.level_offsets[level] + std::size_t(thumbnail_header.slot_sizes[level]) * index;
+        return make_mapped_image(thumbnails, pixels, rows, cols, CV_8UC3);
+    };
+
+    /* Return the pre-parsed frame records of a hot (1.2.0) file, or an empty vector for other versions.
+     */
+    const std::vector<HotFrameRecord>& get_hot_frame_records() const {
+        return hot_frames;
+    };
+
 private:
     std::filesystem::path filepath;
+    std::shared_ptr<FileHandleCache> file_handles;
     const int image_width = 1080;
     const int image_height = 1920;
-    std::size_t initial_frame_index = 8; // 3 signature bytes + 3 version bytes + 2 bytes for num_frames
     std::size_t num_frames = 0;
     MFBAVersion mfba_version;
-    std::vector<FrameLocationInfo> frame_location_info;
+    std::shared_ptr<const FrameLocationInfo[]> frame_location_info; // num_frames entries, owned or in a mapped frame index.
+    std::vector<std::int64_t> frame_timestamps; // Built on demand by get_timestamps(), or read from the frame table of hot files.
+    std::optional<bool> timestamps_are_sorted; // Checked on the first temporal query.
+    std::shared_ptr<const MappedFile> mapping; // Only used for hot files.
+    cv::MatAllocator* mat_allocator = nullptr; // nullptr means OpenCV's default allocator.
+    std::shared_ptr<PolicyFile> policy_file; // Only set for policies other than IOPolicy::standard.
+    std::shared_ptr<SharedFrameCache> shared_frame_cache;
+    std::uint64_t file_fingerprint = 0; // Key of this file in the shared frame cache.
+    std::vector<HotFrameRecord> hot_frames;
+    std::shared_ptr<const MappedFile> thumbnails; // The thumbnail sidecar, mapped by load_thumbnails().
+    ThumbnailSidecarHeader thumbnail_header{};
+    std::optional<MFBAOpenError> open_error; // Set by open() in MFBAOpenMode::partial if frames were dropped.
+
+    /* Construct a reader for a file whose header open() has already read, without reading anything.
+     */
+    FacebowFileReader(const std::filesystem::path& filepath, std::shared_ptr<FileHandleCache> file_handles, const MFBAHeader& header)
+        : filepath(filepath), file_handles(std::move(file_handles)), num_frames(header.num_frames), mfba_version(header.version) {};
 
 
     /* Return the number of images in the given MFBA file.
@@ -289,7 +1239,7 @@ private:
      */
     std::size_t read_image_count() const {
         // Note: 2 bytes are reserved for this in the MFBA file header.
-        auto number_of_frames_as_bytes = read_bytes_from_file(filepath, 6, 2);
+        auto number_of_frames_as_bytes = read_bytes(6, 2);
         if (is_little_endian())
             std::reverse(number_of_frames_as_bytes.begin(), number_of_frames_as_bytes.end());
 
@@ -297,7 +1247,228 @@ private:
         return static_cast<std::size_t>(number_of_frames);
     };
 
-    std::vector<std::byte> XOR(const std::vector<std::byte>& input) { 
+    /* Take the frame table from a mapped frame index, after checking that the index belongs to the file as it is now.
+     */
+    void load_frame_index(std::shared_ptr<const MappedFile> frame_index) {
+        static_assert(std::is_trivially_copyable_v<FrameLocationInfo>);
+        const std::byte* data = frame_index->data();
+        const auto read_field = [&](std::size_t offset, auto value) {
+            std::memcpy(&value, data + offset, sizeof(value));
+            return value;
+        };
+
+        const std::size_t file_size = std::filesystem::file_size(filepath);
+        bool is_valid = frame_index->size() >= frame_index_header_size
+            && std::memcmp(data, frame_index_magic, sizeof(frame_index_magic)) == 0
+            && read_field(8, std::uint32_t()) == frame_index_byte_order_mark
+            && read_field(12, std::uint32_t()) == sizeof(FrameLocationInfo)
+            && read_field(16, std::uint64_t()) == file_size
+            && read_field(24, std::int64_t()) == std::filesystem::last_write_time(filepath).time_since_epoch().count()
+            && read_field(32, std::uint64_t()) == num_frames
+            && MFBAVersion{ std::uint8_t(data[40]), std::uint8_t(data[41]), std::uint8_t(data[42]) } == mfba_version
+            && (frame_index->size() - frame_index_header_size) / sizeof(FrameLocationInfo) >= num_frames;
+
+        // The mapping is page aligned and the header size a multiple of the entry alignment, so the table can be used in place:
+        const auto* locations = reinterpret_cast<const FrameLocationInfo*>(data + frame_index_header_size);
+
+        // A damaged or hand-edited index must not lead reads astray, so hold every entry to the same checks as a scan:
+        std::size_t next_frame_index = mfba_header_size;
+        for (std::size_t i = 0; is_valid && i < num_frames; ++i)
+        {
+            const FrameLocationInfo& location = locations[i];
+            is_valid = location.frame_index == next_frame_index && !check_frame_location(location, file_size, mfba_version);
+            next_frame_index += std::size_t(location.offset_to_header) + location.offset_to_image + location.image_size;
+        }
+        if (!is_valid)
+            throw std::runtime_error(filepath.string() + ": frame index does not match the file");
+
+        frame_location_info = std::shared_ptr<const FrameLocationInfo[]>(frame_index, locations);
+    };
+
+    /* Load the frame table of a hot (1.2.0) file from the footer of its mapping.
+     *
+     * @return A description of the first problem found, or std::nullopt if the hot layout is sound.
+     */
+    std::optional<std::string> load_hot_layout(std::shared_ptr<const MappedFile> mapped_file) {
+        const std::byte* data = mapped_file->data();
+        const std::size_t size = mapped_file->size();
+
+        // A capture without frames is just the file header and the trailer:
+        if (size < mfba_header_size + hot_trailer_size)
+            return "hot MFBA file is truncated";
+        const std::byte* trailer = data + size - hot_trailer_size;
+        if (std::memcmp(trailer + 16, hot_layout_magic, sizeof(hot_layout_magic)) != 0)
+            return "hot MFBA file has no valid footer";
+
+        const auto table_offset = from_big_endian<std::uint64_t>(trailer);
+        const auto table_frame_count = from_big_endian<std::uint32_t>(trailer + 8);
+        const auto record_size = from_big_endian<std::uint32_t>(trailer + 12);
+        if (table_frame_count != num_frames || record_size != hot_frame_record_size
+            || table_offset < mfba_header_size || table_offset > size - hot_trailer_size || (size - hot_trailer_size - table_offset) / record_size < num_frames)
+            return "hot MFBA frame table is inconsistent with the header";
+
+        hot_frames.reserve(num_frames);
+        frame_timestamps.reserve(num_frames);
+        for (std::size_t i = 0; i < num_frames; ++i)
+        {
+            const auto frame = decode_hot_frame_record(data + table_offset + i * record_size);
+            const std::size_t pixel_bytes = static_cast<std::size_t>(frame.rows) * frame.cols * 3;
+            if (frame.pixel_offset % hot_block_alignment != 0 || frame.pixel_offset < mfba_header_size || frame.pixel_offset > table_offset
+                || pixel_bytes > table_offset - frame.pixel_offset
+                || frame.metadata_offset < mfba_header_size || frame.metadata_offset > table_offset || frame.metadata_size > table_offset - frame.metadata_offset)
+                return "hot MFBA frame " + std::to_string(i) + " lies outside the data section";
+            hot_frames.push_back(frame);
+            frame_timestamps.push_back(frame.timestamp);
+        }
+        mapping = std::move(mapped_file);
+        return std::nullopt;
+    };
+
+    /* Return the sensor timestamp of frame \p index in nanoseconds.
+     *
+     * Rather than parsing the whole JSON metadata (which is dominated by ~100 CaptureResult entries), we scan the un-XOR'd
+     * text for the timestamp key and parse the value that follows it. If the metadata is laid out differently than
+     * expected, we fall back to the full get_metadata() parse.
+     */
+    std::int64_t read_timestamp(std::size_t index) {
+        const auto metadata_bytes = read_bytes(frame_location_info[index].frame_index + frame_location_info[index].offset_to_header, frame_location_info[index].offset_to_image);
+        std::string metadata(metadata_bytes.size(), '\0');
+        std::transform(metadata_bytes.begin(), metadata_bytes.end(), metadata.begin(), [](std::byte b) { return static_cast<char>(b ^ std::byte(0xFF)); });
+
+        const std::string key = "\"android.sensor.timestamp\"";
+        const auto key_pos = metadata.find(key);
+        if (key_pos != std::string::npos)
+        {
+            // The value must belong to the same {"key": ..., "value": ...} object as the key:
+            const auto value_pos = metadata.find("\"value\"", key_pos + key.size());
+            const auto object_end = std::min(metadata.find('}', key_pos), metadata.size()); // npos if the object is never closed
+            if (value_pos != std::string::npos && value_pos < object_end)
+            {
+                const auto digits_pos = metadata.find_first_of("-0123456789", value_pos + 7);
+                std::int64_t timestamp = 0;
+                if (digits_pos < object_end)
+                {
+                    const auto [ptr, ec] = std::from_chars(metadata.data() + digits_pos, metadata.data() + object_end, timestamp);
+                    if (ec == std::errc())
+                        return timestamp;
+                }
+            }
+        }
+        return std::stoll(get_metadata(index).at("CaptureResult").at("android.sensor.timestamp"));
+    };
+
+    /* Return get_timestamps(), after checking once that they are in capture order, as the temporal queries require.
+     */
+    const std::vector<std::int64_t>& get_sorted_timestamps() {
+        const auto& timestamps = get_timestamps();
+        if (!timestamps_are_sorted)
+            timestamps_are_sorted = std::is_sorted(timestamps.begin(), timestamps.end());
+        if (!timestamps_are_sorted.value())
+            throw std::runtime_error(filepath.string() + ": frame timestamps are not in capture order");
+        return timestamps;
+    };
+
+    static std::int64_t seconds_to_nanoseconds(double seconds) {
+        return static_cast<std::int64_t>(std::llround(seconds * 1e9));
+    };
+
+    /* Read the image at index \p index, from the mapping, the shared frame cache or by decoding it, and compute its
+     * statistics if \p statistics is given.
+     */
+    cv::Mat load_image(std::size_t index, FrameStatistics* statistics) {
+        if (index >= num_frames)
+            throw std::runtime_error("Image frame out of range, file includes " + std::to_string(num_frames) + " frames");
+
+        if (mapping)
+        {
+            const auto& frame = hot_frames[index];
+            auto image = make_mapped_image(mapping, mapping->data() + frame.pixel_offset, frame.rows, frame.cols, CV_8UC3);
+            if (statistics)
+                *statistics = compute_frame_statistics(image);
+            return image;
+        }
+
+        // Another process on this host may already have decoded the frame:
+        if (shared_frame_cache)
+        {
+            auto image = shared_frame_cache->get(file_fingerprint, index, mat_allocator);
+            if (!image.empty())
+            {
+                if (statistics)
+                    *statistics = compute_frame_statistics(image);
+                return image;
+            }
+        }
+
+        auto image = decode_image(index, statistics);
+        if (shared_frame_cache)
+            shared_frame_cache->put(file_fingerprint, index, image);
+        return image;
+    };
+
+    /* Return the (rows, cols) of the image at index \p index.
+     */
+    std::pair<int, int> get_frame_shape(std::size_t index) const {
+        if (mapping)
+            return { hot_frames[index].rows, hot_frames[index].cols };
+
+		// We need the metadata to know the orientation. Not ideal, but we'll work with it for now. EG are currently not storing the width and height correctly for landscape images, thus we need the if/else below.
+		const auto exif_orientation_value = std::stoi(get_metadata(index).at("Orientation").at("Orientation"));
+
+		// See the different orientation values here: https://developer.android.com/reference/android/media/ExifInterface
+        // 6: ORIENTATION_ROTATE_90: Normal, upright portrait image
+        // 7: ORIENTATION_TRANSVERSE: "flipped about top-right <--> bottom-left axis". Portrait. I think this is when the phone is upside down - and it flips the image so the image itself is upright again.
+        // A StackOverflow post said that these values are further documented in Android's source code in android\media\ExifInterface.java.
+        if (exif_orientation_value == 6 || exif_orientation_value == 7)
+            return { image_height, image_width };
+        // 1: ORIENTATION_NORMAL which means a landscape image - this is the phone rotated to the left.
+        // 3: ORIENTATION_ROTATE_180, which is landscape too - likely the phone rotated to the right.
+        // Note w/h are swapped here - image_width is actually the height, image_height is the width. See comment further above about EG's storing of the width/height.
+        if (exif_orientation_value == 1 || exif_orientation_value == 3)
+            return { image_width, image_height };
+        throw std::runtime_error("Unsupported orientation value: " + std::to_string(exif_orientation_value));
+    };
+
+    /* Un-XOR and lay out the image at index \p index of a 1.0.0 or 1.1.0 file, one row at a time. If \p statistics is given,
+     * each row is added to them right after it has been written, while it is still in the CPU cache.
+     */
+    cv::Mat decode_image(std::size_t index, FrameStatistics* statistics = nullptr) const {
+        // The metadata precedes the image block in the file, so read it first to keep the access pattern front to back:
+        const auto [rows, cols] = get_frame_shape(index);
+        const auto imagedata_bytes = read_image_block(index);
+        const std::size_t row_bytes = std::size_t(cols) * 3;
+
+        cv::Mat image;
+        image.allocator = mat_allocator;
+        image.create(rows, cols, CV_8UC3);
+        std::optional<FrameStatisticsAccumulator> accumulator;
+        if (statistics)
+            accumulator.emplace(cols);
+        for (int row = 0; row < rows; ++row)
+        {
+            // The data is stored in BGR order - since OpenCV uses BGR by default, we don't need to swap the order:
+            auto* destination = image.ptr<std::uint8_t>(row);
+            unxor_bytes(imagedata_bytes.data() + row * row_bytes, destination, row_bytes);
+            if (accumulator)
+                accumulator->add_row(destination);
+        }
+        if (accumulator)
+            *statistics = accumulator->finish();
+        return image;
+    };
+
+    /* Read \p num_bytes bytes of the MFBA file starting at \p start_byte, according to the I/O policy, or through the file
+     * handle cache if there is one.
+     */
+    std::vector<std::byte> read_bytes(std::size_t start_byte, std::size_t num_bytes) const {
+        if (policy_file)
+            return policy_file->read(start_byte, num_bytes);
+        if (file_handles)
+            return file_handles->read(filepath, start_byte, num_bytes);
+        return read_bytes_from_file(filepath, start_byte, num_bytes);
+    };
+
+    static std::vector<std::byte> XOR(const std::vector<std::byte>& input) { 
         std::vector<std::byte> output(input.size());
 		for (std::size_t i = 0; i < input.size(); ++i)
 			output[i] = input[i] ^ std::byte(0xFF);
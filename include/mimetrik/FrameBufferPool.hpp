@@ -0,0 +1,221 @@
+#pragma once
+
+#ifndef MIMETRIK_FRAME_BUFFER_POOL_HPP
+#define MIMETRIK_FRAME_BUFFER_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#ifdef _WIN32
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+
+namespace mimetrik {
+
+/* A cv::MatAllocator that recycles fixed-size frame buffers instead of returning them to the system.
+ *
+ * A decoded frame is ~6 MB, which glibc serves with a fresh mmap/munmap pair per frame and ~1,500 first-touch page faults.
+ * This allocator keeps released buffers of exactly buffer_size bytes in a free list (up to max_pooled_buffers of them) and
+ * hands them out again, so a steady stream of frames stops paying for either. On Linux, buffers are 2 MB aligned and
+ * marked for transparent huge pages, which cuts the page faults of a new buffer from ~1,500 to 3, at the cost of rounding
+ * every buffer up to a multiple of 2 MB. Allocations of any other size are passed through to regular aligned allocation.
+ *
+ * The allocator must outlive every cv::Mat it allocated, hence the process-wide get_shared() instance.
+ */
+class FrameBufferPool : public cv::MatAllocator {
+
+public:
+    struct Stats {
+        std::size_t hits = 0; // Allocations served from the free list.
+        std::size_t misses = 0; // Allocations of buffer_size that needed a new buffer.
+        std::size_t unpooled = 0; // Allocations of another size, passed through.
+        std::size_t outstanding = 0; // Pooled-size buffers currently owned by a cv::Mat.
+        std::size_t pooled = 0; // Buffers currently waiting in the free list.
+        std::size_t buffer_footprint = 0; // Bytes each pooled-size buffer occupies: buffer_size rounded up to the (huge) page size.
+    };
+
+    /* Construct a pool for buffers of \p buffer_size bytes.
+     *
+     * @param[in] buffer_size The size of the buffers to recycle. Defaults to one 1080x1920 BGR frame.
+     * @param[in] max_pooled_buffers The maximum number of released buffers kept for reuse; further ones are freed.
+     * @param[in] use_huge_pages Back buffers with transparent huge pages where supported (Linux). Buffers are then rounded up
+     *                           to a multiple of 2 MiB instead of 4 KiB: a 6,220,800-byte frame occupies 6 MiB (6,291,456
+     *                           bytes, 1.1% or ~2.2 MiB over a full pool of 32 more than with 4 KiB pages), but buffer sizes
+     *                           just above a multiple of 2 MiB can waste up to 2 MiB each. See Stats::buffer_footprint.
+     */
+    explicit FrameBufferPool(std::size_t buffer_size = std::size_t(1080) * 1920 * 3, std::size_t max_pooled_buffers = 32, bool use_huge_pages = true)
+        : buffer_size(buffer_size), max_pooled_buffers(max_pooled_buffers), use_huge_pages(use_huge_pages) {};
+
+    FrameBufferPool(const FrameBufferPool&) = delete;
+    FrameBufferPool& operator=(const FrameBufferPool&) = delete;
+
+    ~FrameBufferPool() override {
+        for (void* buffer : free_buffers)
+            free_aligned(buffer);
+    };
+
+    /* Return a process-wide pool for 1080x1920 BGR frames that is never destroyed, so Mats allocated from it can safely
+     * outlive any reader.
+     */
+    static FrameBufferPool& get_shared() {
+        static FrameBufferPool* shared = new FrameBufferPool();
+        return *shared;
+    };
+
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+        // Compute the total size and fill in the steps the same way cv::Mat's standard allocator does:
+        std::size_t total = CV_ELEM_SIZE(type);
+        for (int i = dims - 1; i >= 0; --i)
+        {
+            if (step)
+            {
+                if (data && step[i] != CV_AUTOSTEP)
+                    total = step[i];
+                else
+                    step[i] = total;
+            }
+            total *= sizes[i];
+        }
+
+        auto* u = new cv::UMatData(this);
+        u->size = total;
+        if (data)
+        {
+            u->data = u->origdata = static_cast<unsigned char*>(data);
+            u->flags |= cv::UMatData::USER_ALLOCATED;
+            return u;
+        }
+        u->data = u->origdata = static_cast<unsigned char*>(acquire(total));
+        return u;
+    };
+
+    bool allocate(cv::UMatData* u, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+        return u != nullptr;
+    };
+
+    void deallocate(cv::UMatData* u) const override {
+        if (!u)
+            return;
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        if (!(u->flags & cv::UMatData::USER_ALLOCATED))
+            release(u->origdata, u->size);
+        delete u;
+    };
+
+    Stats get_stats() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        Stats current = stats;
+        current.pooled = free_buffers.size();
+        current.buffer_footprint = round_up_to_page(buffer_size, use_huge_pages);
+        return current;
+    };
+
+    std::size_t get_buffer_size() const {
+        return buffer_size;
+    };
+
+private:
+    static constexpr std::size_t huge_page_size = std::size_t(2) * 1024 * 1024;
+    static constexpr std::size_t page_size = 4096;
+
+    std::size_t buffer_size;
+    std::size_t max_pooled_buffers;
+    bool use_huge_pages;
+    mutable std::mutex mutex;
+    mutable std::vector<void*> free_buffers;
+    mutable Stats stats;
+
+    void* acquire(std::size_t size) const {
+        if (size != buffer_size)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++stats.unpooled;
+            }
+            return allocate_aligned(size, false);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++stats.outstanding;
+            if (!free_buffers.empty())
+            {
+                ++stats.hits;
+                void* buffer = free_buffers.back();
+                free_buffers.pop_back();
+                return buffer;
+            }
+            ++stats.misses;
+        }
+        try {
+            return allocate_aligned(size, use_huge_pages);
+        }
+        catch (...) {
+            std::lock_guard<std::mutex> lock(mutex);
+            --stats.outstanding;
+            throw;
+        }
+    };
+
+    void release(void* buffer, std::size_t size) const {
+        if (size == buffer_size)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            --stats.outstanding;
+            if (free_buffers.size() < max_pooled_buffers)
+            {
+                free_buffers.push_back(buffer);
+                return;
+            }
+        }
+        free_aligned(buffer);
+    };
+
+    /* Round \p size up to whole (huge) pages, so the tail of a buffer does not share a page with unrelated data.
+     */
+    static std::size_t round_up_to_page(std::size_t size, bool huge_pages) {
+        const std::size_t alignment = huge_pages ? huge_page_size : page_size;
+        return (std::max<std::size_t>(size, 1) + alignment - 1) / alignment * alignment;
+    };
+
+    static void* allocate_aligned(std::size_t size, bool huge_pages) {
+        const std::size_t alignment = huge_pages ? huge_page_size : page_size;
+        const std::size_t rounded_size = round_up_to_page(size, huge_pages);
+#ifdef _WIN32
+        void* buffer = _aligned_malloc(rounded_size, alignment);
+        if (!buffer)
+            throw std::bad_alloc();
+#else
+        void* buffer = nullptr;
+        if (::posix_memalign(&buffer, alignment, rounded_size) != 0)
+            throw std::bad_alloc();
+#ifdef MADV_HUGEPAGE
+        if (huge_pages)
+            ::madvise(buffer, rounded_size, MADV_HUGEPAGE); // Only a hint, failure just means regular pages.
+#endif
+#endif
+        return buffer;
+    };
+
+    static void free_aligned(void* buffer) {
+#ifdef _WIN32
+        _aligned_free(buffer);
+#else
+        std::free(buffer);
+#endif
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_FRAME_BUFFER_POOL_HPP */
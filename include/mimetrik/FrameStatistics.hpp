@@ -0,0 +1,198 @@
+#pragma once
+
+#ifndef MIMETRIK_FRAME_STATISTICS_HPP
+#define MIMETRIK_FRAME_STATISTICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define MIMETRIK_FRAME_STATISTICS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+
+namespace mimetrik {
+
+/* Image quality statistics of one frame, for capture QA.
+ */
+struct FrameStatistics {
+    // Mean luma (BT.601 weights), 0-255.
+    double mean_brightness = 0;
+    // Mean of the blue, green and red channel, 0-255.
+    std::array<double, 3> channel_means{};
+    // Per-channel histograms, in BGR order.
+    std::array<std::array<std::uint32_t, 256>, 3> histograms{};
+    // Variance of the 4-neighbour Laplacian of the luma: low for blurred frames, high for sharp ones.
+    double sharpness = 0;
+};
+
+
+/* Un-XOR \p size bytes as stored in 1.0.0 and 1.1.0 files from \p source into \p destination, 16 bytes at a time with SSE2
+ * where available.
+ */
+inline void unxor_bytes(const std::byte* source, std::uint8_t* destination, std::size_t size)
+{
+    std::size_t i = 0;
+#ifdef MIMETRIK_FRAME_STATISTICS_SSE2
+    const __m128i ones = _mm_set1_epi8(static_cast<char>(0xFF));
+    for (; i + 16 <= size; i += 16)
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i)), ones));
+#endif
+    for (; i < size; ++i)
+        destination[i] = static_cast<std::uint8_t>(source[i] ^ std::byte(0xFF));
+};
+
+
+/* Accumulates FrameStatistics one BGR row at a time, so that the statistics can be computed while a frame is decoded,
+ * on rows that are still in the CPU cache, or without ever holding more than three rows of a frame.
+ */
+class FrameStatisticsAccumulator {
+
+public:
+    explicit FrameStatisticsAccumulator(int cols) : cols(cols), luma_rows{ std::vector<std::int16_t>(cols), std::vector<std::int16_t>(cols), std::vector<std::int16_t>(cols) } {};
+
+    /* Add the next row of the frame: cols BGR pixels.
+     */
+    void add_row(const std::uint8_t* bgr) {
+        // Neighbouring pixels go into two partial tables, so that runs of equal values do not serialise on one counter:
+        auto& even = partial_histograms[0];
+        auto& odd = partial_histograms[1];
+        int col = 0;
+        for (; col + 2 <= cols; col += 2)
+        {
+            const std::uint8_t* pixels = bgr + col * 3;
+            ++even[0][pixels[0]];
+            ++even[1][pixels[1]];
+            ++even[2][pixels[2]];
+            ++odd[0][pixels[3]];
+            ++odd[1][pixels[4]];
+            ++odd[2][pixels[5]];
+        }
+        for (; col < cols; ++col)
+        {
+            ++even[0][bgr[col * 3]];
+            ++even[1][bgr[col * 3 + 1]];
+            ++even[2][bgr[col * 3 + 2]];
+        }
+
+        // Luma in fixed point, (29 B + 150 G + 77 R) / 256:
+        std::int16_t* luma = luma_rows[num_rows % 3].data();
+        std::uint32_t row_luma_sum = 0;
+        for (col = 0; col < cols; ++col)
+        {
+            const std::uint32_t y = (29u * bgr[col * 3] + 150u * bgr[col * 3 + 1] + 77u * bgr[col * 3 + 2] + 128u) >> 8;
+            luma[col] = static_cast<std::int16_t>(y);
+            row_luma_sum += y;
+        }
+        luma_sum += row_luma_sum;
+        ++num_rows;
+
+        // With three rows of luma, the Laplacian of the middle one can be evaluated:
+        if (num_rows >= 3)
+            add_laplacian_row(luma_rows[(num_rows - 3) % 3].data(), luma_rows[(num_rows - 2) % 3].data(), luma);
+    };
+
+    FrameStatistics finish() const {
+        FrameStatistics statistics;
+        const double num_pixels = static_cast<double>(num_rows) * cols;
+        if (num_pixels == 0)
+            return statistics;
+
+        for (int channel = 0; channel < 3; ++channel)
+        {
+            std::uint64_t channel_sum = 0;
+            for (int value = 0; value < 256; ++value)
+            {
+                for (const auto& partial : partial_histograms)
+                    statistics.histograms[channel][value] += partial[channel][value];
+                channel_sum += std::uint64_t(value) * statistics.histograms[channel][value];
+            }
+            statistics.channel_means[channel] = channel_sum / num_pixels;
+        }
+        statistics.mean_brightness = luma_sum / num_pixels;
+
+        const double num_laplacians = static_cast<double>(num_rows > 2 ? num_rows - 2 : 0) * (cols > 2 ? cols - 2 : 0);
+        if (num_laplacians > 0)
+        {
+            const double mean = laplacian_sum / num_laplacians;
+            statistics.sharpness = laplacian_sum_of_squares / num_laplacians - mean * mean;
+        }
+        return statistics;
+    };
+
+private:
+    /* Accumulate the 4-neighbour Laplacian of the \p middle luma row. It lies within [-1020, 1020], so it fits into 16 bits
+     * and its square into 32; with SSE2, 8 pixels are evaluated at a time and squared and summed with pmaddwd.
+     */
+    void add_laplacian_row(const std::int16_t* above, const std::int16_t* middle, const std::int16_t* below) {
+        std::int64_t row_sum = 0, row_sum_of_squares = 0;
+        int col = 1;
+#ifdef MIMETRIK_FRAME_STATISTICS_SSE2
+        const __m128i ones = _mm_set1_epi16(1);
+        __m128i sums = _mm_setzero_si128(), squares = _mm_setzero_si128();
+        // Each 32-bit lane of `squares` gains at most 2 * 1020^2 per iteration, so flush them to 64 bits every 512 pixels:
+        while (col + 8 <= cols - 1)
+        {
+            const int block_end = std::min(cols - 1, col + 512);
+            for (; col + 8 <= block_end; col += 8)
+            {
+                const __m128i centre = _mm_loadu_si128(reinterpret_cast<const __m128i*>(middle + col));
+                __m128i laplacian = _mm_slli_epi16(centre, 2);
+                laplacian = _mm_sub_epi16(laplacian, _mm_loadu_si128(reinterpret_cast<const __m128i*>(above + col)));
+                laplacian = _mm_sub_epi16(laplacian, _mm_loadu_si128(reinterpret_cast<const __m128i*>(below + col)));
+                laplacian = _mm_sub_epi16(laplacian, _mm_loadu_si128(reinterpret_cast<const __m128i*>(middle + col - 1)));
+                laplacian = _mm_sub_epi16(laplacian, _mm_loadu_si128(reinterpret_cast<const __m128i*>(middle + col + 1)));
+                sums = _mm_add_epi32(sums, _mm_madd_epi16(laplacian, ones));
+                squares = _mm_add_epi32(squares, _mm_madd_epi16(laplacian, laplacian));
+            }
+            alignas(16) std::int32_t lanes[4];
+            _mm_store_si128(reinterpret_cast<__m128i*>(lanes), squares);
+            for (const auto lane : lanes)
+                row_sum_of_squares += static_cast<std::uint32_t>(lane);
+            squares = _mm_setzero_si128();
+        }
+        alignas(16) std::int32_t lanes[4];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+        for (const auto lane : lanes)
+            row_sum += lane;
+#endif
+        for (; col < cols - 1; ++col)
+        {
+            const std::int32_t laplacian = 4 * middle[col] - above[col] - below[col] - middle[col - 1] - middle[col + 1];
+            row_sum += laplacian;
+            row_sum_of_squares += laplacian * laplacian;
+        }
+        laplacian_sum += row_sum;
+        laplacian_sum_of_squares += row_sum_of_squares;
+    };
+
+    int cols;
+    std::size_t num_rows = 0;
+    std::uint64_t luma_sum = 0;
+    std::int64_t laplacian_sum = 0;
+    std::int64_t laplacian_sum_of_squares = 0;
+    std::array<std::vector<std::int16_t>, 3> luma_rows; // Ring buffer of the luma of the last three rows.
+    std::array<std::array<std::array<std::uint32_t, 256>, 3>, 2> partial_histograms{};
+};
+
+
+/* Compute the statistics of an already decoded CV_8UC3 image.
+ */
+inline FrameStatistics compute_frame_statistics(const cv::Mat& image)
+{
+    FrameStatisticsAccumulator accumulator(image.cols);
+    for (int row = 0; row < image.rows; ++row)
+        accumulator.add_row(image.ptr<std::uint8_t>(row));
+    return accumulator.finish();
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_FRAME_STATISTICS_HPP */
@@ -0,0 +1,291 @@
+#pragma once
+
+#ifndef MIMETRIK_IO_POLICY_HPP
+#define MIMETRIK_IO_POLICY_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace mimetrik {
+
+/* How a reader should interact with the operating system's page cache.
+ *
+ * The hints need posix_fadvise; on Windows every policy reads like standard, and on macOS, which has no posix_fadvise,
+ * only direct changes anything (through F_NOCACHE).
+ */
+enum class IOPolicy {
+    // Plain buffered reads, leave everything to the kernel.
+    standard,
+    // One pass front to back, e.g. a batch conversion: read ahead aggressively and drop pages that lie more than the
+    // readahead window behind the cursor (POSIX_FADV_DONTNEED), so a multi-gigabyte pass does not evict the working set of
+    // everything else on the host, while a frame's header and metadata stay cached until the frame has been decoded.
+    sequential,
+    // Scattered access, e.g. scrubbing: disable kernel readahead (POSIX_FADV_RANDOM), which would fetch data we never use.
+    random,
+    // Bypass the page cache entirely with O_DIRECT and aligned buffers. Falls back to reads followed by
+    // POSIX_FADV_DONTNEED on file systems that do not support O_DIRECT (e.g. tmpfs).
+    direct,
+};
+
+
+/* Return the name of \p policy, as accepted by parse_io_policy().
+ */
+inline std::string to_string(IOPolicy policy)
+{
+    switch (policy)
+    {
+    case IOPolicy::standard: return "standard";
+    case IOPolicy::sequential: return "sequential";
+    case IOPolicy::random: return "random";
+    case IOPolicy::direct: return "direct";
+    }
+    return "unknown";
+};
+
+
+inline IOPolicy parse_io_policy(const std::string& name)
+{
+    for (const auto policy : { IOPolicy::standard, IOPolicy::sequential, IOPolicy::random, IOPolicy::direct })
+    {
+        if (to_string(policy) == name)
+            return policy;
+    }
+    throw std::runtime_error("Unknown I/O policy: " + name);
+};
+
+
+/* A file opened once and read with positional reads according to an IOPolicy. Reads are thread-safe.
+ */
+class PolicyFile {
+
+public:
+    /* Open \p filepath for reading with the given policy.
+     *
+     * @param[in] filepath The path to the file.
+     * @param[in] policy The page cache policy.
+     * @param[in] readahead_bytes For IOPolicy::sequential, how far ahead of each read to prefetch, and how far behind it
+     *                            pages are kept before they are dropped.
+     */
+    PolicyFile(const std::filesystem::path& filepath, IOPolicy policy, std::size_t readahead_bytes = std::size_t(16) * 1024 * 1024)
+        : filepath(filepath), policy(policy), readahead_bytes(readahead_bytes) {
+#ifdef _WIN32
+        stream.open(filepath, std::ios::binary | std::ios::ate);
+        if (!stream)
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+        file_size = static_cast<std::size_t>(stream.tellg());
+#else
+        int flags = O_RDONLY | O_CLOEXEC;
+#ifdef O_DIRECT
+        if (policy == IOPolicy::direct)
+            flags |= O_DIRECT;
+#endif
+        fd = ::open(filepath.c_str(), flags);
+#ifdef O_DIRECT
+        if (fd < 0 && policy == IOPolicy::direct && errno == EINVAL)
+            fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC); // The file system does not support O_DIRECT.
+        else if (fd >= 0 && policy == IOPolicy::direct)
+            direct = true;
+#endif
+        if (fd < 0)
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+
+        struct stat file_status;
+        if (::fstat(fd, &file_status) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(error));
+        }
+        file_size = static_cast<std::size_t>(file_status.st_size);
+
+#if defined(__APPLE__) && defined(F_NOCACHE)
+        if (policy == IOPolicy::direct)
+            direct = ::fcntl(fd, F_NOCACHE, 1) == 0;
+#endif
+        if (policy == IOPolicy::sequential)
+            advise(0, 0, Advice::sequential);
+        else if (policy == IOPolicy::random)
+            advise(0, 0, Advice::random);
+#endif
+    };
+
+    PolicyFile(const PolicyFile&) = delete;
+    PolicyFile& operator=(const PolicyFile&) = delete;
+
+    ~PolicyFile() {
+#ifndef _WIN32
+        if (fd >= 0)
+            ::close(fd);
+#endif
+    };
+
+    /* Read \p num_bytes bytes starting at \p start_byte and return them.
+     *
+     * Performs the same sanity checks, and throws the same errors, as read_bytes_from_file().
+     */
+    std::vector<std::byte> read(std::size_t start_byte, std::size_t num_bytes) {
+        if (file_size == 0) // avoid undefined behavior
+            throw std::runtime_error(filepath.string() + ": size == 0");
+        if (start_byte > file_size)
+            throw std::runtime_error(filepath.string() + ": start_byte > size");
+        if (start_byte + num_bytes > file_size)
+            throw std::runtime_error(filepath.string() + ": end_byte > size");
+
+        std::vector<std::byte> buffer(num_bytes);
+#ifdef _WIN32
+        std::lock_guard<std::mutex> lock(mutex);
+        stream.clear();
+        stream.seekg(start_byte, std::ios::beg);
+        if (!stream.read((char*)buffer.data(), num_bytes))
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+#else
+        if (direct)
+            read_direct(start_byte, buffer);
+        else
+            read_fully(buffer.data(), start_byte, num_bytes);
+        after_read(start_byte, num_bytes);
+#endif
+        return buffer;
+    };
+
+    IOPolicy get_policy() const {
+        return policy;
+    };
+
+    /* Return whether reads really bypass the page cache (only possible with IOPolicy::direct).
+     */
+    bool is_direct() const {
+        return direct;
+    };
+
+    std::size_t size() const {
+        return file_size;
+    };
+
+    /* Return how many reads under IOPolicy::sequential started in a range the policy had already dropped from the page
+     * cache, i.e. cost an extra synchronous read from disk. Stays 0 for a front-to-back pass.
+     */
+    std::size_t get_reread_count() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return reread_count;
+    };
+
+private:
+    // O_DIRECT requires the file offset, the length and the buffer address to be multiples of the logical block size.
+    // 4 KiB satisfies every common device.
+    static constexpr std::size_t direct_alignment = 4096;
+
+    std::filesystem::path filepath;
+    IOPolicy policy;
+    std::size_t readahead_bytes;
+    std::size_t file_size = 0;
+    bool direct = false;
+    mutable std::mutex mutex;
+    std::size_t reread_count = 0;
+#ifdef _WIN32
+    std::ifstream stream;
+#else
+    int fd = -1;
+    std::size_t dropped_until = 0; // IOPolicy::sequential: everything before this offset has been dropped from the cache.
+
+    enum class Advice { sequential, random, will_need, dont_need };
+
+    void advise([[maybe_unused]] std::size_t offset, [[maybe_unused]] std::size_t length, [[maybe_unused]] Advice advice) {
+#ifdef POSIX_FADV_SEQUENTIAL
+        static constexpr int posix_advice[] = { POSIX_FADV_SEQUENTIAL, POSIX_FADV_RANDOM, POSIX_FADV_WILLNEED, POSIX_FADV_DONTNEED };
+        ::posix_fadvise(fd, static_cast<off_t>(offset), static_cast<off_t>(length), posix_advice[static_cast<int>(advice)]); // Only a hint.
+#endif
+    };
+
+    void read_fully(std::byte* destination, std::size_t offset, std::size_t size) {
+        while (size > 0)
+        {
+            const ssize_t num_read = ::pread(fd, destination, size, static_cast<off_t>(offset));
+            if (num_read < 0 && errno == EINTR)
+                continue;
+            if (num_read <= 0)
+                throw std::runtime_error(filepath.string() + ": " + (num_read == 0 ? std::string("unexpected end of file") : std::strerror(errno)));
+            destination += num_read;
+            offset += static_cast<std::size_t>(num_read);
+            size -= static_cast<std::size_t>(num_read);
+        }
+    };
+
+    /* Read the aligned range that covers the request into an aligned bounce buffer and copy out the requested bytes.
+     */
+    void read_direct(std::size_t start_byte, std::vector<std::byte>& buffer) {
+        const std::size_t aligned_start = start_byte / direct_alignment * direct_alignment;
+        const std::size_t aligned_end = (start_byte + buffer.size() + direct_alignment - 1) / direct_alignment * direct_alignment;
+        const std::size_t aligned_size = aligned_end - aligned_start;
+
+        struct AlignedDeleter {
+            void operator()(std::byte* p) const { std::free(p); }
+        };
+        void* memory = nullptr;
+        if (::posix_memalign(&memory, direct_alignment, aligned_size) != 0)
+            throw std::bad_alloc();
+        std::unique_ptr<std::byte, AlignedDeleter> bounce(static_cast<std::byte*>(memory));
+
+        // The last block of the file may be short, so pread can legitimately return less than aligned_size:
+        std::size_t num_read = 0;
+        while (num_read < aligned_size)
+        {
+            const ssize_t result = ::pread(fd, bounce.get() + num_read, aligned_size - num_read, static_cast<off_t>(aligned_start + num_read));
+            if (result < 0 && errno == EINTR)
+                continue;
+            if (result < 0)
+                throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+            if (result == 0)
+                break;
+            num_read += static_cast<std::size_t>(result);
+        }
+        if (num_read < start_byte - aligned_start + buffer.size())
+            throw std::runtime_error(filepath.string() + ": unexpected end of file");
+        std::memcpy(buffer.data(), bounce.get() + (start_byte - aligned_start), buffer.size());
+    };
+
+    void after_read(std::size_t start_byte, std::size_t num_bytes) {
+        if (policy == IOPolicy::sequential)
+        {
+            // Prefetch the window after this read, and drop what lies more than a window behind it. Dropping everything
+            // before this read would evict e.g. the frame header and metadata just before the frame, which are read again
+            // right after its image block:
+            advise(start_byte + num_bytes, readahead_bytes, Advice::will_need);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (start_byte < dropped_until)
+                ++reread_count;
+            const std::size_t drop_until = start_byte > readahead_bytes ? start_byte - readahead_bytes : 0;
+            if (drop_until > dropped_until)
+            {
+                advise(dropped_until, drop_until - dropped_until, Advice::dont_need);
+                dropped_until = drop_until;
+            }
+        }
+        else if (policy == IOPolicy::direct && !direct)
+        {
+            advise(start_byte, num_bytes, Advice::dont_need);
+        }
+    };
+#endif
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_IO_POLICY_HPP */
@@ -0,0 +1,268 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_CATALOG_HPP
+#define MIMETRIK_MFBA_CATALOG_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <filesystem>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "mimetrik/FacebowFileReader.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
+
+namespace mimetrik {
+
+/* A thread-safe, size-bounded LRU cache of decoded frames, keyed by (file number, frame index).
+ *
+ * The returned cv::Mat shares its pixel buffer with the cache entry, so callers that want to modify an image should clone() it.
+ */
+class FrameCache {
+
+public:
+    using Key = std::pair<std::size_t, std::size_t>;
+
+    explicit FrameCache(std::size_t max_bytes) : max_bytes(max_bytes) {};
+
+    /* Return the cached frame for \p key, or an empty cv::Mat if it is not cached.
+     */
+    cv::Mat get(const Key& key) {
+        std::lock_guard<std::mutex> lock(mutex);
+        const auto it = entries.find(key);
+        if (it == entries.end())
+            return cv::Mat();
+        recently_used.splice(recently_used.begin(), recently_used, it->second.second);
+        return it->second.first;
+    };
+
+    /* Insert \p image under \p key, evicting the least recently used frames until the cache fits into max_bytes again.
+     *
+     * Images larger than the whole cache are not stored.
+     */
+    void put(const Key& key, const cv::Mat& image) {
+        const std::size_t image_bytes = image.total() * image.elemSize();
+        if (image_bytes > max_bytes)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        if (entries.contains(key))
+            return;
+        while (current_bytes + image_bytes > max_bytes && !recently_used.empty())
+        {
+            const auto& evicted = entries.at(recently_used.back()).first;
+            current_bytes -= evicted.total() * evicted.elemSize();
+            entries.erase(recently_used.back());
+            recently_used.pop_back();
+        }
+        recently_used.push_front(key);
+        entries.emplace(key, std::make_pair(image, recently_used.begin()));
+        current_bytes += image_bytes;
+    };
+
+    std::size_t get_size_bytes() const {
+        std::lock_guard<std::mutex> lock(mutex);
+        return current_bytes;
+    };
+
+private:
+    std::size_t max_bytes;
+    std::size_t current_bytes = 0;
+    mutable std::mutex mutex;
+    std::list<Key> recently_used; // Most recently used at the front.
+    std::map<Key, std::pair<cv::Mat, std::list<Key>::iterator>> entries;
+};
+
+
+/* A catalog of several MFBA files (e.g. one patient session) presented as a single sequence of frames.
+ *
+ * Only the 8-byte header of each file is read up front (in parallel), which is enough to build the global frame index. The
+ * frame table of a member file is built the first time one of its frames is accessed. All member files share one bounded
+ * file handle cache, one decode thread pool and one frame cache, so the number of open file descriptors stays bounded no
+ * matter how many captures the catalog spans.
+ */
+class MFBACatalog {
+
+public:
+    struct Options {
+        std::size_t max_open_files = 64;
+        std::size_t num_decode_threads = std::thread::hardware_concurrency();
+        std::size_t frame_cache_bytes = std::size_t(256) * 1024 * 1024;
+        // Allocator for decoded frames of all member files, e.g. &FrameBufferPool::get_shared(). Must outlive the images.
+        cv::MatAllocator* mat_allocator = nullptr;
+        // Cache shared with other processes on this host, consulted by every member file before decoding a frame.
+        std::shared_ptr<SharedFrameCache> shared_frame_cache;
+    };
+
+    /* Construct a catalog of all .mfba files in \p directory, ordered by file name.
+     *
+     * @param[in] directory The directory to scan (not recursive).
+     * @param[in] options Resource limits shared by all member files.
+     */
+    MFBACatalog(const std::filesystem::path& directory, const Options& options) : MFBACatalog(list_mfba_files(directory), options) {};
+
+    explicit MFBACatalog(const std::filesystem::path& directory) : MFBACatalog(directory, Options{}) {};
+
+    /* Construct a catalog of the given MFBA files, in the given order.
+     *
+     * @param[in] files The paths to the MFBA files.
+     * @param[in] options Resource limits shared by all member files.
+     */
+    MFBACatalog(const std::vector<std::filesystem::path>& files, const Options& options)
+        : files(files),
+          file_handles(std::make_shared<FileHandleCache>(options.max_open_files)),
+          decode_pool(options.num_decode_threads),
+          frame_cache(options.frame_cache_bytes),
+          mat_allocator(options.mat_allocator),
+          shared_frame_cache(options.shared_frame_cache),
+          readers(files.size()),
+          reader_init(files.size()) {
+
+        // Probe all headers in parallel, with a single 8-byte read per file:
+        std::vector<MFBAHeader> headers(files.size());
+        decode_pool.parallel_for(files.size(), [&](std::size_t i) {
+            if (!std::filesystem::exists(files[i]))
+                throw std::runtime_error(files[i].string() + ": file does not exist");
+            const auto header = parse_mfba_header(file_handles->read(files[i], 0, mfba_header_size));
+            if (!header)
+                throw std::runtime_error(files[i].string() + ": invalid MFBA header");
+            if (!is_supported_mfba_version(header->version))
+                throw std::runtime_error(files[i].string() + ": " + get_unsupported_mfba_version_message());
+            headers[i] = header.value();
+        });
+
+        // first_frame[i] is the global index of the first frame of file i, first_frame.back() the total frame count:
+        first_frame.reserve(files.size() + 1);
+        first_frame.push_back(0);
+        for (const auto& header : headers)
+            first_frame.push_back(first_frame.back() + header.num_frames);
+    };
+
+    explicit MFBACatalog(const std::vector<std::filesystem::path>& files) : MFBACatalog(files, Options{}) {};
+
+    /* Return the number of member files.
+     */
+    std::size_t get_file_count() const {
+        return files.size();
+    };
+
+    /* Return the path of member file \p file_number.
+     */
+    const std::filesystem::path& get_file(std::size_t file_number) const {
+        return files.at(file_number);
+    };
+
+    /* Return the total number of images across all member files.
+     */
+    std::size_t get_image_count() const {
+        return first_frame.back();
+    };
+
+    /* Map a global frame index to the member file that contains it and the frame index within that file.
+     *
+     * @param[in] index The global frame index.
+     * @return A pair of (file number, frame index within the file).
+     */
+    std::pair<std::size_t, std::size_t> locate(std::size_t index) const {
+        if (index >= get_image_count())
+            throw std::runtime_error("Image frame out of range, catalog includes " + std::to_string(get_image_count()) + " frames");
+        // Find the last file whose first frame is <= index (skipping over empty files):
+        const auto it = std::upper_bound(first_frame.begin(), first_frame.end(), index) - 1;
+        const auto file_number = static_cast<std::size_t>(it - first_frame.begin());
+        return { file_number, index - *it };
+    };
+
+    /* Return the reader for member file \p file_number, building its frame table on first use.
+     */
+    FacebowFileReader& get_reader(std::size_t file_number) {
+        std::call_once(reader_init.at(file_number), [&] {
+            readers[file_number] = std::make_unique<FacebowFileReader>(files[file_number], file_handles);
+            readers[file_number]->set_mat_allocator(mat_allocator);
+            readers[file_number]->set_shared_frame_cache(shared_frame_cache);
+        });
+        return *readers[file_number];
+    };
+
+    /* Read the image metadata at global index \p index.
+     */
+    std::map<std::string, std::map<std::string, std::string>> get_metadata(std::size_t index) {
+        const auto [file_number, frame] = locate(index);
+        return get_reader(file_number).get_metadata(frame);
+    };
+
+    /* Read the image at global index \p index, from the shared frame cache if possible.
+     *
+     * The returned image shares its pixels with the frame cache, clone() it before modifying it.
+     */
+    cv::Mat get_image(std::size_t index) {
+        const auto location = locate(index);
+        auto image = frame_cache.get(location);
+        if (image.empty())
+        {
+            image = get_reader(location.first).get_image(location.second);
+            frame_cache.put(location, image);
+        }
+        return image;
+    };
+
+    /* Read the images at the given global indices, decoding them in parallel on the shared decode thread pool.
+     *
+     * @param[in] indices The global frame indices to read.
+     * @return The images, in the order of \p indices.
+     */
+    std::vector<cv::Mat> get_images(const std::vector<std::size_t>& indices) {
+        std::vector<cv::Mat> images(indices.size());
+        decode_pool.parallel_for(indices.size(), [&](std::size_t i) {
+            images[i] = get_image(indices[i]);
+        });
+        return images;
+    };
+
+    const FileHandleCache& get_file_handle_cache() const {
+        return *file_handles;
+    };
+
+    const FrameCache& get_frame_cache() const {
+        return frame_cache;
+    };
+
+private:
+    std::vector<std::filesystem::path> files;
+    std::vector<std::size_t> first_frame;
+    std::shared_ptr<FileHandleCache> file_handles;
+    ThreadPool decode_pool;
+    FrameCache frame_cache;
+    cv::MatAllocator* mat_allocator;
+    std::shared_ptr<SharedFrameCache> shared_frame_cache;
+    std::vector<std::unique_ptr<FacebowFileReader>> readers;
+    std::vector<std::once_flag> reader_init;
+
+    /* Return all regular files with the .mfba extension in \p directory, sorted by path.
+     */
+    static std::vector<std::filesystem::path> list_mfba_files(const std::filesystem::path& directory) {
+        if (!std::filesystem::is_directory(directory))
+            throw std::runtime_error(directory.string() + ": not a directory");
+
+        std::vector<std::filesystem::path> mfba_files;
+        for (const auto& entry : std::filesystem::directory_iterator(directory))
+        {
+            if (entry.is_regular_file() && entry.path().extension() == ".mfba")
+                mfba_files.push_back(entry.path());
+        }
+        std::sort(mfba_files.begin(), mfba_files.end());
+        return mfba_files;
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_CATALOG_HPP */
@@ -0,0 +1,68 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_COMPRESSION_HPP
+#define MIMETRIK_MFBA_COMPRESSION_HPP
+
+#include <cstddef>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "zstd.h"
+
+
+namespace mimetrik {
+
+/* Compress one MFBA image block with zstd.
+ *
+ * MFBA 1.1.0 stores every image block as an independent zstd frame, so frames can be decompressed in any order and in
+ * parallel. The content size is recorded in the zstd frame header, which lets the reader validate it before decompressing.
+ *
+ * @param[in] image_block The (XOR'd) image block, as stored in an MFBA 1.0.0 file.
+ * @param[in] compression_level The zstd compression level. Low levels are recommended, decompression speed barely depends on it.
+ * @return The compressed block.
+ */
+inline std::vector<std::byte> compress_image_block(const std::vector<std::byte>& image_block, int compression_level = 3) {
+    std::vector<std::byte> compressed(ZSTD_compressBound(image_block.size()));
+    const std::size_t compressed_size = ZSTD_compress(compressed.data(), compressed.size(), image_block.data(), image_block.size(), compression_level);
+    if (ZSTD_isError(compressed_size))
+        throw std::runtime_error(std::string("zstd compression failed: ") + ZSTD_getErrorName(compressed_size));
+    compressed.resize(compressed_size);
+    return compressed;
+};
+
+
+/* Decompress one MFBA 1.1.0 image block.
+ *
+ * Each calling thread keeps its own decompression context, so concurrent calls do not contend and do not reallocate the
+ * decoder state for every frame.
+ *
+ * @param[in] compressed_block The compressed image block.
+ * @param[in] expected_size The size the decompressed block must have.
+ * @return The decompressed (still XOR'd) image block.
+ */
+inline std::vector<std::byte> decompress_image_block(const std::vector<std::byte>& compressed_block, std::size_t expected_size) {
+    const auto content_size = ZSTD_getFrameContentSize(compressed_block.data(), compressed_block.size());
+    if (content_size == ZSTD_CONTENTSIZE_ERROR || content_size == ZSTD_CONTENTSIZE_UNKNOWN)
+        throw std::runtime_error("Compressed image block has an invalid zstd frame header");
+    if (content_size != expected_size)
+        throw std::runtime_error("Compressed image block has size " + std::to_string(content_size) + ", expected " + std::to_string(expected_size));
+
+    struct ContextDeleter {
+        void operator()(ZSTD_DCtx* context) const { ZSTD_freeDCtx(context); }
+    };
+    thread_local std::unique_ptr<ZSTD_DCtx, ContextDeleter> context(ZSTD_createDCtx());
+
+    std::vector<std::byte> image_block(expected_size);
+    const std::size_t decompressed_size = ZSTD_decompressDCtx(context.get(), image_block.data(), image_block.size(), compressed_block.data(), compressed_block.size());
+    if (ZSTD_isError(decompressed_size))
+        throw std::runtime_error(std::string("zstd decompression failed: ") + ZSTD_getErrorName(decompressed_size));
+    if (decompressed_size != expected_size)
+        throw std::runtime_error("Compressed image block decompressed to " + std::to_string(decompressed_size) + " bytes, expected " + std::to_string(expected_size));
+    return image_block;
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_COMPRESSION_HPP */
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_HOT_LAYOUT_HPP
+#define MIMETRIK_MFBA_HOT_LAYOUT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+namespace mimetrik {
+
+/* The "hot" MFBA layout (version 1.2.0), written by repack_mfba_hot() and optimised for reading from a memory mapping:
+ *
+ *   [0, 8)              The usual 8-byte MFBA header: "FFF", version 1.2.0, big endian frame count.
+ *   [4096, ...)         One pixel block per frame: plain (not XOR'd) BGR bytes in cv::Mat row-major order, each block
+ *                       starting on a hot_block_alignment boundary.
+ *   ...                 One metadata blob per frame: the parsed metadata map serialised as CBOR.
+ *   table_offset        The frame table: one hot_frame_record_size record per frame (see HotFrameRecord).
+ *   size - 24           The trailer: table offset (u64), frame count (u32), record size (u32), hot_layout_magic (8 bytes).
+ *
+ * All integers are big endian, like in the rest of the format.
+ */
+inline constexpr std::size_t hot_block_alignment = 4096;
+inline constexpr std::size_t hot_frame_record_size = 40;
+inline constexpr std::size_t hot_trailer_size = 24;
+inline constexpr char hot_layout_magic[8] = { 'M', 'F', 'B', 'A', 'H', 'O', 'T', '1' };
+
+
+/* Stores the pre-parsed information for a frame of a hot MFBA file.
+ */
+struct HotFrameRecord {
+    std::uint64_t pixel_offset;
+    std::uint64_t metadata_offset;
+    std::uint32_t metadata_size;
+    std::uint16_t rows;
+    std::uint16_t cols;
+    std::uint8_t orientation;
+    std::int64_t timestamp;
+};
+
+
+/* Return the smallest multiple of hot_block_alignment that is >= \p offset.
+ */
+inline std::size_t align_to_hot_block(std::size_t offset)
+{
+    return (offset + hot_block_alignment - 1) / hot_block_alignment * hot_block_alignment;
+};
+
+
+/* Serialise \p record into hot_frame_record_size big endian bytes.
+ */
+inline std::vector<std::byte> encode_hot_frame_record(const HotFrameRecord& record)
+{
+    std::vector<std::byte> bytes;
+    bytes.reserve(hot_frame_record_size);
+    const auto put = [&bytes](std::uint64_t value, std::size_t num_bytes) {
+        for (std::size_t i = num_bytes; i-- > 0;)
+            bytes.push_back(static_cast<std::byte>((value >> (8 * i)) & 0xFF));
+    };
+    put(record.pixel_offset, 8);
+    put(record.metadata_offset, 8);
+    put(record.metadata_size, 4);
+    put(record.rows, 2);
+    put(record.cols, 2);
+    put(record.orientation, 1);
+    put(0, 7); // Padding, keeps the timestamp 8-byte aligned within the record.
+    put(static_cast<std::uint64_t>(record.timestamp), 8);
+    return bytes;
+};
+
+
+/* Parse a record written by encode_hot_frame_record() from \p bytes.
+ */
+inline HotFrameRecord decode_hot_frame_record(const std::byte* bytes)
+{
+    const auto get = [bytes](std::size_t offset, std::size_t num_bytes) {
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < num_bytes; ++i)
+            value = (value << 8) | static_cast<std::uint64_t>(bytes[offset + i]);
+        return value;
+    };
+    return HotFrameRecord{
+        get(0, 8),
+        get(8, 8),
+        static_cast<std::uint32_t>(get(16, 4)),
+        static_cast<std::uint16_t>(get(20, 2)),
+        static_cast<std::uint16_t>(get(22, 2)),
+        static_cast<std::uint8_t>(get(24, 1)),
+        static_cast<std::int64_t>(get(32, 8))
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_HOT_LAYOUT_HPP */
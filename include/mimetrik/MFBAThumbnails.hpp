@@ -0,0 +1,188 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_THUMBNAILS_HPP
+#define MIMETRIK_MFBA_THUMBNAILS_HPP
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <vector>
+
+
+namespace mimetrik {
+
+/* The thumbnail sidecar "<file>.thumbs", written by FacebowFileReader::write_thumbnails() and read through a memory
+ * mapping by FacebowFileReader::get_thumbnail():
+ *
+ *   [0, 64)             The header (see ThumbnailSidecarHeader): thumbnail_sidecar_magic, the size and last write time of
+ *                       the MFBA file it belongs to, the frame count, and per level its downscale factor, slot size and
+ *                       offset.
+ *   [64, ...)           The frame table: the rows (u16) and cols (u16) of every full-size frame.
+ *   level offsets       Per level, one slot of `slot size` bytes per frame, holding the thumbnail as plain BGR bytes in
+ *                       cv::Mat row-major order. Each level starts on a thumbnail_block_alignment boundary.
+ *
+ * All integers are big endian, like in the rest of the format. Level 0 is 1/4 of the frame size in each dimension, level 1
+ * is 1/16; both are box-filtered averages of the full-size pixels.
+ */
+inline constexpr char thumbnail_sidecar_magic[8] = { 'M', 'F', 'B', 'A', 'T', 'H', 'M', '1' };
+inline constexpr std::size_t thumbnail_header_size = 64;
+inline constexpr std::size_t thumbnail_frame_record_size = 4;
+inline constexpr std::size_t thumbnail_block_alignment = 4096;
+inline constexpr std::array<std::uint32_t, 2> thumbnail_factors = { 4, 16 };
+
+
+struct ThumbnailSidecarHeader {
+    std::uint64_t mfba_file_size;
+    std::int64_t mfba_write_time;
+    std::uint32_t num_frames;
+    std::array<std::uint32_t, thumbnail_factors.size()> slot_sizes;
+    std::array<std::uint64_t, thumbnail_factors.size()> level_offsets;
+};
+
+
+/* Return the path of the thumbnail sidecar of \p mfba_file: "<mfba_file>.thumbs".
+ */
+inline std::filesystem::path get_thumbnail_sidecar_path(const std::filesystem::path& mfba_file)
+{
+    auto sidecar = mfba_file;
+    sidecar += ".thumbs";
+    return sidecar;
+};
+
+
+/* Serialise \p header into thumbnail_header_size big endian bytes.
+ */
+inline std::vector<std::byte> encode_thumbnail_sidecar_header(const ThumbnailSidecarHeader& header)
+{
+    std::vector<std::byte> bytes;
+    bytes.reserve(thumbnail_header_size);
+    for (const char c : thumbnail_sidecar_magic)
+        bytes.push_back(static_cast<std::byte>(c));
+    const auto put = [&bytes](std::uint64_t value, std::size_t num_bytes) {
+        for (std::size_t i = num_bytes; i-- > 0;)
+            bytes.push_back(static_cast<std::byte>((value >> (8 * i)) & 0xFF));
+    };
+    put(header.mfba_file_size, 8);
+    put(static_cast<std::uint64_t>(header.mfba_write_time), 8);
+    put(header.num_frames, 4);
+    put(thumbnail_factors.size(), 4);
+    for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+    {
+        put(thumbnail_factors[level], 4);
+        put(header.slot_sizes[level], 4);
+        put(header.level_offsets[level], 8);
+    }
+    return bytes;
+};
+
+
+/* Parse a header written by encode_thumbnail_sidecar_header() from the first \p size bytes of a sidecar.
+ *
+ * @return The header, or std::nullopt if the bytes are not a thumbnail sidecar header with the expected levels.
+ */
+inline std::optional<ThumbnailSidecarHeader> decode_thumbnail_sidecar_header(const std::byte* bytes, std::size_t size)
+{
+    const auto get = [bytes](std::size_t offset, std::size_t num_bytes) {
+        std::uint64_t value = 0;
+        for (std::size_t i = 0; i < num_bytes; ++i)
+            value = (value << 8) | static_cast<std::uint64_t>(bytes[offset + i]);
+        return value;
+    };
+    if (size < thumbnail_header_size || !std::equal(thumbnail_sidecar_magic, thumbnail_sidecar_magic + 8, reinterpret_cast<const char*>(bytes)))
+        return std::nullopt;
+    if (get(28, 4) != thumbnail_factors.size())
+        return std::nullopt;
+
+    ThumbnailSidecarHeader header{ get(8, 8), static_cast<std::int64_t>(get(16, 8)), static_cast<std::uint32_t>(get(24, 4)), {}, {} };
+    for (std::size_t level = 0; level < thumbnail_factors.size(); ++level)
+    {
+        if (get(32 + level * 16, 4) != thumbnail_factors[level])
+            return std::nullopt;
+        header.slot_sizes[level] = static_cast<std::uint32_t>(get(36 + level * 16, 4));
+        header.level_offsets[level] = get(40 + level * 16, 8);
+    }
+    return header;
+};
+
+
+/* Downscale a full-size BGR frame by 4 and by 16 in each dimension (box filter, rows and columns that do not fill a whole
+ * box are dropped), in a single pass over the full-size pixels.
+ *
+ * The pixels may still be XOR'd with 0xFF as stored in 1.0.0 and 1.1.0 files: the sum of un-XOR'd bytes over a box of n
+ * bytes is 255 * n minus the sum of the stored bytes, so the full-size image is never un-XOR'd or materialised.
+ *
+ * @param[in] pixels rows * cols * 3 bytes of BGR pixels.
+ * @param[in] rows, cols The size of the full-size frame.
+ * @param[in] xored Whether \p pixels are XOR'd with 0xFF.
+ * @param[out] thumbnails Per level, receives (rows / factor) * (cols / factor) * 3 bytes.
+ */
+inline void downscale_frame(const std::byte* pixels, int rows, int cols, bool xored, std::array<std::vector<std::byte>, thumbnail_factors.size()>& thumbnails)
+{
+    constexpr std::uint32_t small = thumbnail_factors[0], large = thumbnail_factors[1], ratio = large / small;
+    const int small_rows = rows / small, small_cols = cols / small;
+    const int large_rows = rows / large, large_cols = cols / large;
+    const std::size_t small_row_bytes = std::size_t(small_cols) * 3, large_row_bytes = std::size_t(large_cols) * 3;
+    const std::uint8_t* source = reinterpret_cast<const std::uint8_t*>(pixels);
+
+    thumbnails[0].resize(small_row_bytes * small_rows);
+    thumbnails[1].resize(large_row_bytes * large_rows);
+
+    // Box sums of the small level, and of the large level accumulated from them, so both are exact box averages:
+    std::vector<std::uint32_t> small_sums(small_row_bytes), large_sums(large_row_bytes);
+    const auto to_average = [xored](std::uint32_t sum, std::uint32_t box_bytes) {
+        if (xored)
+            sum = 255 * box_bytes - sum;
+        return static_cast<std::byte>((sum + box_bytes / 2) / box_bytes);
+    };
+
+    for (int small_row = 0; small_row < small_rows; ++small_row)
+    {
+        std::fill(small_sums.begin(), small_sums.end(), 0);
+        for (std::uint32_t r = 0; r < small; ++r)
+        {
+            const std::uint8_t* row = source + (std::size_t(small_row) * small + r) * std::size_t(cols) * 3;
+            for (int small_col = 0; small_col < small_cols; ++small_col)
+            {
+                const std::uint8_t* box = row + std::size_t(small_col) * small * 3;
+                std::uint32_t* sum = small_sums.data() + std::size_t(small_col) * 3;
+                for (std::uint32_t c = 0; c < small; ++c)
+                {
+                    sum[0] += box[c * 3];
+                    sum[1] += box[c * 3 + 1];
+                    sum[2] += box[c * 3 + 2];
+                }
+            }
+        }
+
+        std::byte* small_out = thumbnails[0].data() + std::size_t(small_row) * small_row_bytes;
+        for (std::size_t i = 0; i < small_row_bytes; ++i)
+            small_out[i] = to_average(small_sums[i], small * small);
+
+        const int large_row = small_row / ratio;
+        if (large_row >= large_rows)
+            continue;
+        if (small_row % ratio == 0)
+            std::fill(large_sums.begin(), large_sums.end(), 0);
+        for (int large_col = 0; large_col < large_cols; ++large_col)
+        {
+            for (std::uint32_t c = 0; c < ratio; ++c)
+            {
+                for (int channel = 0; channel < 3; ++channel)
+                    large_sums[std::size_t(large_col) * 3 + channel] += small_sums[(std::size_t(large_col) * ratio + c) * 3 + channel];
+            }
+        }
+        if (small_row % ratio == ratio - 1)
+        {
+            std::byte* large_out = thumbnails[1].data() + std::size_t(large_row) * large_row_bytes;
+            for (std::size_t i = 0; i < large_row_bytes; ++i)
+                large_out[i] = to_average(large_sums[i], large * large);
+        }
+    }
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_THUMBNAILS_HPP */
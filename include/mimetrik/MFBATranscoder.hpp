@@ -0,0 +1,225 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_TRANSCODER_HPP
+#define MIMETRIK_MFBA_TRANSCODER_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mimetrik/FacebowFileReader.hpp"
+#ifndef MIMETRIK_NO_ZSTD
+#include "mimetrik/MFBACompression.hpp"
+#endif
+#include "mimetrik/MFBAHotLayout.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
+
+namespace mimetrik {
+
+/* Append \p value to \p output as a big endian integer of sizeof(T) bytes.
+ */
+template <typename T>
+inline void write_big_endian(std::ofstream& output, T value)
+{
+    for (std::size_t i = sizeof(T); i-- > 0;)
+        output.put(static_cast<char>((value >> (8 * i)) & 0xFF));
+};
+
+/* Write \p output_file with \p write_contents(std::ofstream&), through a temporary file that is only renamed into place once
+ * it is complete. A failure part way through then never leaves a file with a valid header but truncated contents behind.
+ */
+template <typename WriteContents>
+inline void write_file_atomically(const std::filesystem::path& output_file, WriteContents&& write_contents)
+{
+    auto temporary_file = output_file;
+    temporary_file += ".tmp" + std::to_string(std::random_device()());
+    try {
+        {
+            std::ofstream output(temporary_file, std::ios::binary | std::ios::trunc);
+            if (!output)
+                throw std::runtime_error(output_file.string() + ": " + std::strerror(errno));
+            write_contents(output);
+            output.close();
+            if (!output)
+                throw std::runtime_error(output_file.string() + ": write failed");
+        }
+        std::filesystem::rename(temporary_file, output_file);
+    }
+    catch (...) {
+        std::error_code error;
+        std::filesystem::remove(temporary_file, error);
+        throw;
+    }
+};
+
+
+/* Convert an MFBA file (of any supported version) to the raw (1.0.0) or the compressed (1.1.0) version.
+ *
+ * The metadata blocks are copied unchanged. The image blocks are decompressed and/or compressed in parallel, in batches of
+ * one frame per worker thread, and written out in order, so memory use is bounded by the batch size rather than the
+ * capture length. Converting a file to its own version is allowed and rewrites it in canonical layout.
+ *
+ * @param[in] input_file The MFBA file to read.
+ * @param[in] output_file The MFBA file to write. Must not be the same as \p input_file.
+ * @param[in] target_version mfba_version_raw or mfba_version_compressed (not available with MIMETRIK_NO_ZSTD).
+ * @param[in] compression_level The zstd compression level used when writing 1.1.0.
+ * @param[in] num_threads The number of threads to (de)compress with.
+ */
+inline void transcode_mfba(const std::filesystem::path& input_file, const std::filesystem::path& output_file, MFBAVersion target_version,
+    [[maybe_unused]] int compression_level = 3, std::size_t num_threads = std::thread::hardware_concurrency())
+{
+    if ((target_version != mfba_version_raw && target_version != mfba_version_compressed) || !is_supported_mfba_version(target_version))
+        throw std::runtime_error("Cannot transcode to unsupported MFBA version " + target_version.to_string());
+    if (std::filesystem::exists(output_file) && std::filesystem::equivalent(input_file, output_file))
+        throw std::runtime_error(output_file.string() + ": output file must differ from the input file");
+
+    FacebowFileReader reader(input_file);
+    const std::size_t num_frames = reader.get_image_count();
+
+    write_file_atomically(output_file, [&](std::ofstream& output) {
+        output.write("FFF", 3);
+        output.put(static_cast<char>(target_version.major));
+        output.put(static_cast<char>(target_version.minor));
+        output.put(static_cast<char>(target_version.patch));
+        write_big_endian(output, static_cast<std::uint16_t>(num_frames));
+
+        ThreadPool pool(num_threads);
+        const std::size_t batch_size = pool.get_thread_count();
+        std::vector<std::vector<std::byte>> metadata_blocks(batch_size);
+        std::vector<std::vector<std::byte>> image_blocks(batch_size);
+
+        for (std::size_t batch_start = 0; batch_start < num_frames; batch_start += batch_size)
+        {
+            const std::size_t batch_end = std::min(batch_start + batch_size, num_frames);
+            pool.parallel_for(batch_end - batch_start, [&](std::size_t i) {
+                metadata_blocks[i] = reader.read_metadata_block(batch_start + i);
+                image_blocks[i] = reader.read_image_block(batch_start + i);
+#ifndef MIMETRIK_NO_ZSTD
+                if (target_version == mfba_version_compressed)
+                    image_blocks[i] = compress_image_block(image_blocks[i], compression_level);
+#endif
+            });
+
+            for (std::size_t i = 0; i < batch_end - batch_start; ++i)
+            {
+                // Frame header: offset to the metadata, metadata size (= offset to the image relative to the metadata), image block size:
+                write_big_endian(output, std::uint32_t{ 12 });
+                write_big_endian(output, static_cast<std::uint32_t>(metadata_blocks[i].size()));
+                write_big_endian(output, static_cast<std::uint32_t>(image_blocks[i].size()));
+                output.write(reinterpret_cast<const char*>(metadata_blocks[i].data()), metadata_blocks[i].size());
+                output.write(reinterpret_cast<const char*>(image_blocks[i].data()), image_blocks[i].size());
+            }
+            if (!output)
+                throw std::runtime_error(output_file.string() + ": write failed");
+        }
+    });
+};
+
+
+/* Repack an MFBA file into the hot (1.2.0) layout described in MFBAHotLayout.hpp.
+ *
+ * Every frame is decoded once (un-XOR'd, oriented, metadata parsed) in parallel batches, and its pixels are written plain
+ * and 4 KiB-aligned, so that FacebowFileReader can later return them as zero-copy views of a mapping. The result
+ * is slightly larger than a 1.0.0 file because of the alignment padding. It can be transcoded back to 1.0.0 or 1.1.0 with
+ * transcode_mfba(); the metadata is then re-serialised, so it is equivalent but not byte-identical to the original.
+ *
+ * @param[in] input_file The MFBA file to read (any supported version).
+ * @param[in] output_file The hot MFBA file to write. Must not be the same as \p input_file.
+ * @param[in] num_threads The number of threads to decode with.
+ */
+inline void repack_mfba_hot(const std::filesystem::path& input_file, const std::filesystem::path& output_file,
+    std::size_t num_threads = std::thread::hardware_concurrency())
+{
+    if (std::filesystem::exists(output_file) && std::filesystem::equivalent(input_file, output_file))
+        throw std::runtime_error(output_file.string() + ": output file must differ from the input file");
+
+    FacebowFileReader reader(input_file);
+    const std::size_t num_frames = reader.get_image_count();
+    const auto& timestamps = reader.get_timestamps();
+
+    write_file_atomically(output_file, [&](std::ofstream& output) {
+        std::size_t position = 0;
+        const auto write_bytes = [&](const void* data, std::size_t size) {
+            output.write(static_cast<const char*>(data), size);
+            position += size;
+        };
+        const auto pad_to_block = [&]() {
+            const std::vector<char> padding(align_to_hot_block(position) - position, 0);
+            write_bytes(padding.data(), padding.size());
+        };
+
+        const char header[6] = { 'F', 'F', 'F', static_cast<char>(mfba_version_hot.major), static_cast<char>(mfba_version_hot.minor), static_cast<char>(mfba_version_hot.patch) };
+        write_bytes(header, sizeof(header));
+        const char frame_count[2] = { static_cast<char>(num_frames >> 8), static_cast<char>(num_frames & 0xFF) };
+        write_bytes(frame_count, sizeof(frame_count));
+
+        // Pixel section. Each batch is decoded in parallel and then written out in frame order:
+        ThreadPool pool(num_threads);
+        const std::size_t batch_size = pool.get_thread_count();
+        std::vector<cv::Mat> images(batch_size);
+        std::vector<std::vector<std::uint8_t>> metadata_blobs(num_frames);
+        std::vector<HotFrameRecord> records(num_frames);
+
+        for (std::size_t batch_start = 0; batch_start < num_frames; batch_start += batch_size)
+        {
+            const std::size_t batch_end = std::min(batch_start + batch_size, num_frames);
+            pool.parallel_for(batch_end - batch_start, [&](std::size_t i) {
+                const std::size_t frame = batch_start + i;
+                const auto metadata = reader.get_metadata(frame);
+                images[i] = reader.get_image(frame);
+                if (!images[i].isContinuous())
+                    images[i] = images[i].clone();
+                metadata_blobs[frame] = nlohmann::json::to_cbor(nlohmann::json(metadata));
+                records[frame].rows = static_cast<std::uint16_t>(images[i].rows);
+                records[frame].cols = static_cast<std::uint16_t>(images[i].cols);
+                records[frame].orientation = static_cast<std::uint8_t>(std::stoi(metadata.at("Orientation").at("Orientation")));
+                records[frame].timestamp = timestamps[frame];
+            });
+
+            for (std::size_t i = 0; i < batch_end - batch_start; ++i)
+            {
+                pad_to_block();
+                records[batch_start + i].pixel_offset = position;
+                write_bytes(images[i].data, images[i].total() * images[i].elemSize());
+            }
+            if (!output)
+                throw std::runtime_error(output_file.string() + ": write failed");
+        }
+
+        // Metadata section:
+        for (std::size_t frame = 0; frame < num_frames; ++frame)
+        {
+            records[frame].metadata_offset = position;
+            records[frame].metadata_size = static_cast<std::uint32_t>(metadata_blobs[frame].size());
+            write_bytes(metadata_blobs[frame].data(), metadata_blobs[frame].size());
+        }
+
+        // Frame table and trailer:
+        const std::uint64_t table_offset = position;
+        for (const auto& record : records)
+        {
+            const auto record_bytes = encode_hot_frame_record(record);
+            write_bytes(record_bytes.data(), record_bytes.size());
+        }
+        write_big_endian(output, table_offset);
+        write_big_endian(output, static_cast<std::uint32_t>(num_frames));
+        write_big_endian(output, static_cast<std::uint32_t>(hot_frame_record_size));
+        output.write(hot_layout_magic, sizeof(hot_layout_magic));
+        if (!output)
+            throw std::runtime_error(output_file.string() + ": write failed");
+    });
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_TRANSCODER_HPP */
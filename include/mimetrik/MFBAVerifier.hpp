@@ -0,0 +1,312 @@
+#pragma once
+
+#ifndef MIMETRIK_MFBA_VERIFIER_HPP
+#define MIMETRIK_MFBA_VERIFIER_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "nlohmann/json.hpp"
+#ifndef MIMETRIK_NO_ZSTD
+#include "zstd.h"
+#endif
+
+#include "mimetrik/CRC32C.hpp"
+#include "mimetrik/FacebowFileReader.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
+
+namespace mimetrik {
+
+struct MFBAVerifyOptions {
+    // Compute a CRC32C per frame. Without it, only the frame table is validated, which reads 12 bytes per frame.
+    bool compute_checksums = true;
+    // Only checksum frames in [first_frame, first_frame + max_frames), e.g. to scrub a large archive a slice at a time.
+    std::size_t first_frame = 0;
+    std::size_t max_frames = std::numeric_limits<std::size_t>::max();
+    // Compare the computed checksums with the ones stored in the sidecar file, if it exists.
+    bool compare_with_sidecar = true;
+    // Write the computed checksums to the sidecar file. Checksums of frames outside the checked slice are kept from the old sidecar.
+    bool update_sidecar = false;
+};
+
+
+struct MFBAVerifyReport {
+    std::filesystem::path file;
+    std::size_t num_frames = 0; // As announced by the file header.
+    std::size_t num_valid_frames = 0; // Frames before the first structural error.
+    std::optional<std::string> structural_error; // The first structural problem found, if any.
+    std::vector<std::optional<std::uint32_t>> checksums; // CRC32C per frame, std::nullopt if not computed.
+    std::vector<std::size_t> checksum_mismatches; // Frames whose checksum differs from the sidecar.
+    bool sidecar_found = false;
+    // The file size recorded in the sidecar, if it differs from the size of the file. The sidecar then belongs to another
+    // version of the file, and its checksums are not compared.
+    std::optional<std::size_t> sidecar_file_size_mismatch;
+
+    bool is_ok() const {
+        return !structural_error && checksum_mismatches.empty() && !sidecar_file_size_mismatch;
+    };
+};
+
+
+/* Return the path of the checksum sidecar file of \p mfba_file: "<mfba_file>.crc32c.json".
+ */
+inline std::filesystem::path get_checksum_sidecar_path(const std::filesystem::path& mfba_file)
+{
+    auto sidecar = mfba_file;
+    sidecar += ".crc32c.json";
+    return sidecar;
+};
+
+
+namespace detail {
+
+/* The byte ranges that make up one frame on disk and that its checksum covers.
+ */
+struct FrameExtent {
+    std::vector<std::pair<std::size_t, std::size_t>> ranges; // (offset, size)
+};
+
+/* Validate the frame table of a 1.0.0 or 1.1.0 file with a single file handle, without reading any pixels (see
+ * FacebowFileReader::scan_frame_table()).
+ *
+ * Stops at the first bad frame. For 1.1.0 files, the zstd frame header of every image block is checked to announce the
+ * expected decompressed size, which only reads a few bytes per frame.
+ */
+inline void validate_frame_table(const std::filesystem::path& mfba_file, const MFBAHeader& header, std::size_t file_size,
+    MFBAVerifyReport& report, std::vector<FrameExtent>& extents)
+{
+    std::ifstream ifs(mfba_file, std::ios::binary);
+    if (!ifs)
+    {
+        report.structural_error = mfba_file.string() + ": " + std::strerror(errno);
+        return;
+    }
+
+    std::vector<FacebowFileReader::FrameLocationInfo> locations;
+    const auto table_error = FacebowFileReader::scan_frame_table(ifs, file_size, header, locations);
+
+    for (std::size_t i = 0; i < locations.size(); ++i)
+    {
+        const auto& location = locations[i];
+#ifndef MIMETRIK_NO_ZSTD
+        if (header.version == mfba_version_compressed)
+        {
+            const auto fail = [&](const std::string& error) {
+                report.structural_error = "frame " + std::to_string(i) + " at byte " + std::to_string(location.frame_index) + ": " + error;
+            };
+            std::byte zstd_header[18]; // ZSTD_FRAMEHEADERSIZE_MAX, which zstd.h only exposes with ZSTD_STATIC_LINKING_ONLY
+            const std::size_t zstd_header_size = std::min<std::size_t>(sizeof(zstd_header), location.image_size);
+            ifs.clear();
+            ifs.seekg(location.frame_index + location.offset_to_header + location.offset_to_image);
+            if (!ifs.read(reinterpret_cast<char*>(zstd_header), zstd_header_size))
+                return fail("cannot read compressed image block");
+            const auto content_size = ZSTD_getFrameContentSize(zstd_header, zstd_header_size);
+            if (content_size != FacebowFileReader::expected_image_size)
+                return fail("compressed image block does not announce " + std::to_string(FacebowFileReader::expected_image_size) + " bytes");
+        }
+#endif
+
+        const std::size_t frame_size = location.offset_to_header + std::size_t(location.offset_to_image) + location.image_size;
+        extents.push_back(FrameExtent{ { { location.frame_index, frame_size } } });
+        report.num_valid_frames = i + 1;
+    }
+    if (table_error)
+        report.structural_error = table_error->to_string();
+};
+
+/* Compute the CRC32C of the given byte ranges of \p mfba_file, reading in 1 MiB chunks.
+ */
+inline std::uint32_t checksum_ranges(const std::filesystem::path& mfba_file, const FrameExtent& extent)
+{
+    std::ifstream ifs(mfba_file, std::ios::binary);
+    if (!ifs)
+        throw std::runtime_error(mfba_file.string() + ": " + std::strerror(errno));
+
+    std::vector<std::byte> buffer(std::size_t(1) << 20);
+    std::uint32_t crc = 0;
+    for (const auto& [offset, size] : extent.ranges)
+    {
+        ifs.seekg(offset);
+        for (std::size_t remaining = size; remaining > 0;)
+        {
+            const std::size_t chunk = std::min(remaining, buffer.size());
+            if (!ifs.read(reinterpret_cast<char*>(buffer.data()), chunk))
+                throw std::runtime_error(mfba_file.string() + ": read failed at byte " + std::to_string(offset + size - remaining));
+            crc = crc32c(crc, buffer.data(), chunk);
+            remaining -= chunk;
+        }
+    }
+    return crc;
+};
+
+} // namespace detail
+
+
+/* Verify the integrity of an MFBA file without decoding any pixels.
+ *
+ * First the whole frame table is validated: every frame must lie within the file, and image blocks must have the size the
+ * format requires (see FacebowFileReader::check_frame_location). Then, unless disabled, a CRC32C of every frame (its
+ * frame header, metadata and image block; for hot files its pixel block and metadata blob) is computed in parallel on
+ * \p pool, using the SSE4.2 crc32 instruction where available. If a sidecar file with earlier checksums exists, the new
+ * checksums are compared with it, which detects corruption that the structure check cannot see.
+ *
+ * Structural problems and checksum mismatches are reported, not thrown. Exceptions are only thrown for I/O errors during
+ * checksumming.
+ *
+ * @param[in] mfba_file The MFBA file to verify.
+ * @param[in] options What to check and whether to update the sidecar.
+ * @param[in] pool The thread pool to checksum frames on.
+ * @return The verification report.
+ */
+inline MFBAVerifyReport verify_mfba(const std::filesystem::path& mfba_file, const MFBAVerifyOptions& options, ThreadPool& pool)
+{
+    MFBAVerifyReport report;
+    report.file = mfba_file;
+
+    std::error_code error_code;
+    const auto file_size = std::filesystem::file_size(mfba_file, error_code);
+    if (error_code)
+    {
+        report.structural_error = mfba_file.string() + ": " + error_code.message();
+        return report;
+    }
+    if (file_size < mfba_header_size)
+    {
+        report.structural_error = "file is " + std::to_string(file_size) + " bytes, too small for the MFBA header";
+        return report;
+    }
+
+    const auto header = parse_mfba_header(read_bytes_from_file(mfba_file, 0, mfba_header_size));
+    if (!header)
+    {
+        report.structural_error = "invalid MFBA header";
+        return report;
+    }
+    report.num_frames = header->num_frames;
+    if (!is_supported_mfba_version(header->version))
+    {
+        report.structural_error = get_unsupported_mfba_version_message() + " (" + header->version.to_string() + ")";
+        return report;
+    }
+
+    std::vector<detail::FrameExtent> extents;
+    if (header->version == mfba_version_hot)
+    {
+        // The hot layout is validated by the reader when it loads the frame table from the footer:
+        try {
+            const FacebowFileReader reader(mfba_file);
+            for (const auto& frame : reader.get_hot_frame_records())
+            {
+                const std::size_t pixel_bytes = std::size_t(frame.rows) * frame.cols * 3;
+                extents.push_back(detail::FrameExtent{ { { frame.pixel_offset, pixel_bytes }, { frame.metadata_offset, frame.metadata_size } } });
+            }
+            report.num_valid_frames = extents.size();
+        }
+        catch (const std::runtime_error& e) {
+            report.structural_error = e.what();
+        }
+    }
+    else
+    {
+        detail::validate_frame_table(mfba_file, header.value(), file_size, report, extents);
+    }
+
+    report.checksums.assign(report.num_frames, std::nullopt);
+    if (options.compute_checksums)
+    {
+        // Frames past a structural error are not checksummed, their location cannot be trusted:
+        const std::size_t first = std::min(options.first_frame, extents.size());
+        const std::size_t count = std::min(options.max_frames, extents.size() - first);
+        pool.parallel_for(count, [&](std::size_t i) {
+            report.checksums[first + i] = detail::checksum_ranges(mfba_file, extents[first + i]);
+        });
+    }
+
+    // Compare with and/or update the sidecar. Each entry records the frame's location, so a stored checksum is never
+    // compared against a frame at a different position:
+    const auto sidecar_path = get_checksum_sidecar_path(mfba_file);
+    nlohmann::json sidecar_frames = nlohmann::json::array();
+    if (std::filesystem::exists(sidecar_path))
+    {
+        std::ifstream sidecar_file(sidecar_path);
+        const auto sidecar = nlohmann::json::parse(sidecar_file, nullptr, false);
+        if (!sidecar.is_discarded() && sidecar.value("algorithm", "") == "crc32c" && sidecar.contains("frames"))
+        {
+            report.sidecar_found = true;
+            sidecar_frames = sidecar["frames"];
+            if (sidecar.contains("file_size") && sidecar["file_size"].is_number_unsigned() && sidecar["file_size"].get<std::size_t>() != file_size)
+                report.sidecar_file_size_mismatch = sidecar["file_size"].get<std::size_t>();
+        }
+    }
+
+    const auto frame_offset = [&](std::size_t frame) { return extents[frame].ranges.front().first; };
+    if (options.compare_with_sidecar && report.sidecar_found && !report.sidecar_file_size_mismatch)
+    {
+        for (std::size_t frame = 0; frame < extents.size(); ++frame)
+        {
+            if (!report.checksums[frame] || frame >= sidecar_frames.size() || sidecar_frames[frame].is_null())
+                continue;
+            const auto& stored = sidecar_frames[frame];
+            if (stored.value("offset", std::size_t(0)) != frame_offset(frame) || stored.value("crc32c", std::uint32_t(0)) != report.checksums[frame].value())
+                report.checksum_mismatches.push_back(frame);
+        }
+    }
+
+    if (options.update_sidecar && !report.structural_error)
+    {
+        nlohmann::json updated_frames = nlohmann::json::array();
+        for (std::size_t frame = 0; frame < extents.size(); ++frame)
+        {
+            if (report.checksums[frame])
+                updated_frames.push_back({ { "offset", frame_offset(frame) }, { "crc32c", report.checksums[frame].value() } });
+            else if (frame < sidecar_frames.size() && !sidecar_frames[frame].is_null() && sidecar_frames[frame].value("offset", std::size_t(0)) == frame_offset(frame))
+                updated_frames.push_back(sidecar_frames[frame]);
+            else
+                updated_frames.push_back(nullptr);
+        }
+        const nlohmann::json sidecar = {
+            { "algorithm", "crc32c" },
+            { "version", header->version.to_string() },
+            { "file_size", file_size },
+            { "frames", updated_frames }
+        };
+        // Like the frame index and the thumbnails, write to a temporary file and rename it into place, so a crash never
+        // leaves a truncated sidecar behind that would report false corruption:
+        auto temporary_file = sidecar_path;
+        temporary_file += ".tmp" + std::to_string(std::random_device()());
+        {
+            std::ofstream sidecar_file(temporary_file, std::ios::trunc);
+            sidecar_file << sidecar.dump(1);
+            if (!sidecar_file)
+            {
+                sidecar_file.close();
+                std::filesystem::remove(temporary_file);
+                throw std::runtime_error(temporary_file.string() + ": write failed");
+            }
+        }
+        std::filesystem::rename(temporary_file, sidecar_path);
+    }
+
+    return report;
+};
+
+
+inline MFBAVerifyReport verify_mfba(const std::filesystem::path& mfba_file, const MFBAVerifyOptions& options = {})
+{
+    ThreadPool pool;
+    return verify_mfba(mfba_file, options, pool);
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MFBA_VERIFIER_HPP */
@@ -0,0 +1,136 @@
+#pragma once
+
+#ifndef MIMETRIK_MAPPED_FILE_HPP
+#define MIMETRIK_MAPPED_FILE_HPP
+
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace mimetrik {
+
+/* A read-only memory mapping of a whole file.
+ *
+ * The file descriptor (or handle) is closed as soon as the mapping exists, so a mapping does not count against the open
+ * file limit. By default the mapped pages are read-only: writing through data() crashes the process. A copy-on-write
+ * mapping may be written to; a written page becomes a private copy of this mapping and the file is never modified.
+ */
+class MappedFile {
+
+public:
+    explicit MappedFile(const std::filesystem::path& filepath, bool copy_on_write = false) {
+#ifdef _WIN32
+        const HANDLE file = CreateFileW(filepath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            throw std::runtime_error(filepath.string() + ": cannot open file for mapping");
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+        {
+            CloseHandle(file);
+            throw std::runtime_error(filepath.string() + ": cannot determine file size");
+        }
+        mapped_size = static_cast<std::size_t>(file_size.QuadPart);
+        if (mapped_size == 0)
+        {
+            CloseHandle(file);
+            throw std::runtime_error(filepath.string() + ": size == 0");
+        }
+        const HANDLE mapping = CreateFileMappingW(file, nullptr, copy_on_write ? PAGE_WRITECOPY : PAGE_READONLY, 0, 0, nullptr);
+        CloseHandle(file);
+        if (mapping == nullptr)
+            throw std::runtime_error(filepath.string() + ": cannot create file mapping");
+        mapped_data = static_cast<const std::byte*>(MapViewOfFile(mapping, copy_on_write ? FILE_MAP_COPY : FILE_MAP_READ, 0, 0, 0));
+        CloseHandle(mapping);
+        if (mapped_data == nullptr)
+            throw std::runtime_error(filepath.string() + ": cannot map file");
+#else
+        const int fd = ::open(filepath.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+        struct stat file_status;
+        if (::fstat(fd, &file_status) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(error));
+        }
+        mapped_size = static_cast<std::size_t>(file_status.st_size);
+        if (mapped_size == 0)
+        {
+            ::close(fd);
+            throw std::runtime_error(filepath.string() + ": size == 0");
+        }
+        void* mapping = ::mmap(nullptr, mapped_size, copy_on_write ? PROT_READ | PROT_WRITE : PROT_READ, copy_on_write ? MAP_PRIVATE : MAP_SHARED, fd, 0);
+        const int error = errno;
+        ::close(fd);
+        if (mapping == MAP_FAILED)
+            throw std::runtime_error(filepath.string() + ": " + std::strerror(error));
+        mapped_data = static_cast<const std::byte*>(mapping);
+#endif
+    };
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept
+        : mapped_data(std::exchange(other.mapped_data, nullptr)), mapped_size(std::exchange(other.mapped_size, 0)) {};
+
+    MappedFile& operator=(MappedFile&& other) noexcept {
+        if (this != &other)
+        {
+            unmap();
+            mapped_data = std::exchange(other.mapped_data, nullptr);
+            mapped_size = std::exchange(other.mapped_size, 0);
+        }
+        return *this;
+    };
+
+    ~MappedFile() {
+        unmap();
+    };
+
+    const std::byte* data() const {
+        return mapped_data;
+    };
+
+    std::size_t size() const {
+        return mapped_size;
+    };
+
+private:
+    const std::byte* mapped_data = nullptr;
+    std::size_t mapped_size = 0;
+
+    void unmap() {
+        if (mapped_data == nullptr)
+            return;
+#ifdef _WIN32
+        UnmapViewOfFile(mapped_data);
+#else
+        ::munmap(const_cast<std::byte*>(mapped_data), mapped_size);
+#endif
+        mapped_data = nullptr;
+        mapped_size = 0;
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MAPPED_FILE_HPP */
@@ -0,0 +1,69 @@
+#pragma once
+
+#ifndef MIMETRIK_MAPPED_IMAGE_HPP
+#define MIMETRIK_MAPPED_IMAGE_HPP
+
+#include <cstddef>
+#include <memory>
+
+#include "opencv2/core.hpp"
+
+#include "mimetrik/MappedFile.hpp"
+
+
+namespace mimetrik {
+
+/* A cv::MatAllocator for images that point into a MappedFile instead of owning their pixels.
+ *
+ * Every such image holds a reference to its MappedFile, so the mapping stays alive for as long as any image (or copy of the
+ * cv::Mat header) still uses it, even after the reader that created it was destroyed or reloaded. The allocator only
+ * releases these references; it never allocates pixels itself.
+ */
+class MappedImageAllocator : public cv::MatAllocator {
+
+public:
+    /* Return the process-wide instance, which is never destroyed, so images can safely outlive any reader.
+     */
+    static MappedImageAllocator& get_shared() {
+        static MappedImageAllocator* shared = new MappedImageAllocator();
+        return *shared;
+    };
+
+    cv::UMatData* allocate(int /*dims*/, const int* /*sizes*/, int /*type*/, void* /*data*/, size_t* /*step*/, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+        return nullptr; // Never set as a cv::Mat's allocator, images are only created by make_mapped_image().
+    };
+
+    bool allocate(cv::UMatData* u, cv::AccessFlag /*flags*/, cv::UMatUsageFlags /*usage_flags*/) const override {
+        return u != nullptr;
+    };
+
+    void deallocate(cv::UMatData* u) const override {
+        if (!u)
+            return;
+        CV_Assert(u->urefcount == 0);
+        CV_Assert(u->refcount == 0);
+        delete static_cast<std::shared_ptr<const MappedFile>*>(u->userdata);
+        delete u;
+    };
+};
+
+/* Wrap \p rows x \p cols pixels of \p type at \p data, which must lie inside \p mapped_file, in a cv::Mat that keeps
+ * \p mapped_file alive. No pixels are copied.
+ *
+ * The pixels are only safe to write to if \p mapped_file is a copy-on-write mapping. Writes are then private to this
+ * process, but visible to every other image of the same pixels from the same mapping.
+ */
+inline cv::Mat make_mapped_image(std::shared_ptr<const MappedFile> mapped_file, const std::byte* data, int rows, int cols, int type) {
+    cv::Mat image(rows, cols, type, const_cast<std::byte*>(data));
+    auto* u = new cv::UMatData(&MappedImageAllocator::get_shared());
+    u->data = u->origdata = image.data;
+    u->size = image.total() * image.elemSize();
+    u->userdata = new std::shared_ptr<const MappedFile>(std::move(mapped_file));
+    u->refcount = 1;
+    image.u = u;
+    return image;
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_MAPPED_IMAGE_HPP */
@@ -0,0 +1,141 @@
+#pragma once
+
+#ifndef MIMETRIK_SHARED_FACEBOW_FILE_READER_HPP
+#define MIMETRIK_SHARED_FACEBOW_FILE_READER_HPP
+
+#include <cstddef>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "opencv2/core.hpp"
+
+#include "mimetrik/FacebowFileReader.hpp"
+#include "mimetrik/MappedFile.hpp"
+
+#ifdef _WIN32
+#include <process.h>
+#else
+#include <unistd.h>
+#endif
+
+
+namespace mimetrik {
+
+/* A FacebowFileReader for multi-process consumers, e.g. the forked workers of a PyTorch DataLoader.
+ *
+ * The frame table is built once, by the first process that opens the file, and written to a frame index (see
+ * FacebowFileReader::write_frame_index()). Every process then maps that index read-only, so the table exists once in the
+ * page cache rather than once per worker, and no worker repeats the sweep over the frame headers.
+ *
+ * The underlying reader is opened lazily and reopened in any process other than the one that opened it, so an instance
+ * that was inherited through fork() never uses file descriptors, mappings or locks of its parent. An instance is fully
+ * described by its two paths, which makes it cheap to pickle for spawn-based multiprocessing.
+ *
+ * Like FacebowFileReader, an instance must not be used from several threads at once.
+ */
+class SharedFacebowFileReader {
+
+public:
+    /* Construct a reader for \p filepath and make sure that its frame index exists and is up to date.
+     *
+     * @param[in] filepath The path to the MFBA file.
+     * @param[in] index_file Where to keep the frame index. Defaults to get_frame_index_path(filepath); pass another path
+     *                       (e.g. in /dev/shm) if the directory of the MFBA file is not writable.
+     * @param[in] build_index Whether to build a missing or stale index now. If false, nothing is opened until first use,
+     *                        opening fails if the index is not valid then, and an empty \p index_file means that the file
+     *                        is read without an index (as get_index_path() returns for hot files).
+     */
+    explicit SharedFacebowFileReader(const std::filesystem::path& filepath, const std::filesystem::path& index_file = {}, bool build_index = true)
+        : filepath(filepath), index_file(index_file.empty() && build_index ? get_frame_index_path(filepath) : index_file) {
+        if (!build_index)
+            return;
+
+        const auto [is_valid, mfba_version] = validate_mfba_header(filepath);
+        if (!is_valid)
+            throw std::runtime_error(filepath.string() + ": invalid MFBA header");
+        if (mfba_version.value() == mfba_version_hot)
+        {
+            // Hot files are mapped by the reader and carry their own frame table, there is nothing to index:
+            this->index_file.clear();
+            return;
+        }
+
+        try {
+            open();
+        }
+        catch (const std::runtime_error&) {
+            FacebowFileReader(filepath).write_frame_index(this->index_file);
+            open();
+        }
+    };
+
+    /* Return the reader of the current process, opening it from the frame index if necessary.
+     */
+    FacebowFileReader& get_reader() {
+        if (!reader || owner_process_id != current_process_id())
+            open();
+        return *reader;
+    };
+
+    std::size_t get_image_count() {
+        return get_reader().get_image_count();
+    };
+
+    cv::Mat get_image(std::size_t index) {
+        return get_reader().get_image(index);
+    };
+
+    std::vector<cv::Mat> get_images(const std::vector<std::size_t>& indices) {
+        return get_reader().get_images(indices);
+    };
+
+    std::map<std::string, std::map<std::string, std::string>> get_metadata(std::size_t index) {
+        return get_reader().get_metadata(index);
+    };
+
+    const std::vector<std::int64_t>& get_timestamps() {
+        return get_reader().get_timestamps();
+    };
+
+    const std::filesystem::path& get_filepath() const {
+        return filepath;
+    };
+
+    /* Return the path of the frame index, or an empty path for hot (1.2.0) files, which do not need one.
+     */
+    const std::filesystem::path& get_index_path() const {
+        return index_file;
+    };
+
+private:
+    std::filesystem::path filepath;
+    std::filesystem::path index_file;
+    std::unique_ptr<FacebowFileReader> reader;
+    long long owner_process_id = 0;
+
+    static long long current_process_id() {
+#ifdef _WIN32
+        return _getpid();
+#else
+        return ::getpid();
+#endif
+    };
+
+    void open() {
+        // A reader inherited from the parent process is dropped; destroying it only releases this process's copies of
+        // the parent's descriptors and mappings.
+        reader.reset();
+        if (index_file.empty())
+            reader = std::make_unique<FacebowFileReader>(filepath);
+        else
+            reader = std::make_unique<FacebowFileReader>(filepath, nullptr, std::make_shared<const MappedFile>(index_file));
+        owner_process_id = current_process_id();
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_SHARED_FACEBOW_FILE_READER_HPP */
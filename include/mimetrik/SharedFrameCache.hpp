@@ -0,0 +1,365 @@
+#pragma once
+
+#ifndef MIMETRIK_SHARED_FRAME_CACHE_HPP
+#define MIMETRIK_SHARED_FRAME_CACHE_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include "opencv2/core.hpp"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+namespace mimetrik {
+
+/* Return a 64-bit fingerprint of the file at \p filepath that identifies its current contents: its device and inode (so
+ * that different paths to the same file agree), size and modification time. Rewriting the file changes the fingerprint.
+ */
+inline std::uint64_t get_file_fingerprint(const std::filesystem::path& filepath)
+{
+    std::uint64_t hash = 14695981039346656037ull; // FNV-1a
+    const auto mix = [&](std::uint64_t value) {
+        for (int i = 0; i < 8; ++i)
+        {
+            hash ^= (value >> (8 * i)) & 0xFF;
+            hash *= 1099511628211ull;
+        }
+    };
+#ifdef _WIN32
+    mix(std::hash<std::wstring>()(std::filesystem::canonical(filepath).wstring()));
+    mix(std::filesystem::file_size(filepath));
+    mix(static_cast<std::uint64_t>(std::filesystem::last_write_time(filepath).time_since_epoch().count()));
+#else
+    struct stat file_status;
+    if (::stat(filepath.c_str(), &file_status) != 0)
+        throw std::runtime_error(filepath.string() + ": " + std::strerror(errno));
+    mix(static_cast<std::uint64_t>(file_status.st_dev));
+    mix(static_cast<std::uint64_t>(file_status.st_ino));
+    mix(static_cast<std::uint64_t>(file_status.st_size));
+#ifdef __APPLE__
+    const auto& modification_time = file_status.st_mtimespec;
+#else
+    const auto& modification_time = file_status.st_mtim;
+#endif
+    mix(static_cast<std::uint64_t>(modification_time.tv_sec) * 1'000'000'000ull + static_cast<std::uint64_t>(modification_time.tv_nsec));
+#endif
+    return hash;
+};
+
+
+/* A cache of decoded frames in POSIX shared memory (/dev/shm), shared by all processes on the host that open it with the
+ * same name, keyed by (file fingerprint, frame index).
+ *
+ * The segment holds a fixed number of slots of slot_size bytes each, so its total size is bounded. A frame hashes to a
+ * set of `ways` neighbouring slots; inserting it evicts the least recently used slot of that set. Slots are claimed and
+ * read without locks: each has a sequence number that is odd while a writer owns the slot. A writer claims a slot by
+ * compare-and-swap from even to odd (and simply skips caching if another process got there first), and a reader copies
+ * the frame out and accepts it only if the sequence number did not change meanwhile. Nobody ever waits for another
+ * process, and a process that dies mid-write only loses that one slot until the segment is removed.
+ *
+ * Not available on Windows, where the constructor throws.
+ */
+class SharedFrameCache {
+
+public:
+    struct Stats {
+        std::size_t hits = 0;
+        std::size_t misses = 0;
+        std::size_t insertions = 0;
+        std::size_t skipped_insertions = 0; // Insertions abandoned because the slot was claimed by another writer.
+    };
+
+    /* Open the shared frame cache \p name, creating it if it does not exist yet.
+     *
+     * @param[in] name The name of the shared memory object, e.g. "/mimetrik-frame-cache".
+     * @param[in] capacity_bytes The total size of the slots. Every process must pass the same geometry.
+     * @param[in] slot_size The maximum size of a cached frame. Defaults to one 1080x1920 BGR frame.
+     * @param[in] ways The number of slots a frame may be placed in.
+     */
+    explicit SharedFrameCache(const std::string& name, std::size_t capacity_bytes = std::size_t(1) << 30,
+        std::size_t slot_size = std::size_t(1080) * 1920 * 3, std::size_t ways = 8)
+        : name(name) {
+#ifdef _WIN32
+        (void)capacity_bytes; (void)slot_size; (void)ways;
+        throw std::runtime_error(name + ": shared frame caches require POSIX shared memory");
+#else
+        const std::size_t aligned_slot_size = (slot_size + page_size - 1) / page_size * page_size;
+        const std::size_t slot_count = capacity_bytes / aligned_slot_size;
+        if (slot_count == 0 || ways == 0)
+            throw std::runtime_error(name + ": shared frame cache capacity is smaller than one slot");
+        const std::size_t slot_table_size = (slot_count * sizeof(Slot) + page_size - 1) / page_size * page_size;
+        mapped_size = page_size + slot_table_size + slot_count * aligned_slot_size;
+
+        bool created = true;
+        int fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0 && errno == EEXIST)
+        {
+            created = false;
+            fd = ::shm_open(name.c_str(), O_RDWR, 0600);
+        }
+        if (fd < 0)
+            throw std::runtime_error(name + ": " + std::strerror(errno));
+
+        if (created && ::ftruncate(fd, static_cast<off_t>(mapped_size)) != 0)
+        {
+            const int error = errno;
+            ::close(fd);
+            ::shm_unlink(name.c_str());
+            throw std::runtime_error(name + ": " + std::strerror(error));
+        }
+        if (!created && !wait_for_size(fd))
+        {
+            ::close(fd);
+            throw std::runtime_error(name + ": shared frame cache exists with a different size");
+        }
+
+        void* memory = ::mmap(nullptr, mapped_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (memory == MAP_FAILED)
+            throw std::runtime_error(name + ": " + std::strerror(errno));
+        base = static_cast<std::byte*>(memory);
+        header = reinterpret_cast<Header*>(base);
+        slots = reinterpret_cast<Slot*>(base + page_size);
+        data = base + page_size + slot_table_size;
+
+        if (created)
+        {
+            // The segment is zero-filled, i.e. every slot is empty. Publish the geometry, then the magic number last:
+            header->layout_version = layout_version;
+            header->slot_count = slot_count;
+            header->slot_size = aligned_slot_size;
+            header->ways = ways;
+            std::atomic_ref<std::uint64_t>(header->magic).store(magic, std::memory_order_release);
+        }
+        else
+        {
+            const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+            while (std::atomic_ref<std::uint64_t>(header->magic).load(std::memory_order_acquire) != magic)
+            {
+                if (std::chrono::steady_clock::now() > deadline)
+                {
+                    ::munmap(base, mapped_size);
+                    throw std::runtime_error(name + ": shared frame cache was never initialised");
+                }
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            if (header->layout_version != layout_version || header->slot_count != slot_count || header->slot_size != aligned_slot_size || header->ways != ways)
+            {
+                ::munmap(base, mapped_size);
+                throw std::runtime_error(name + ": shared frame cache exists with a different geometry");
+            }
+        }
+#endif
+    };
+
+    SharedFrameCache(const SharedFrameCache&) = delete;
+    SharedFrameCache& operator=(const SharedFrameCache&) = delete;
+
+    ~SharedFrameCache() {
+#ifndef _WIN32
+        if (base)
+            ::munmap(base, mapped_size);
+#endif
+    };
+
+    /* Remove the shared memory object \p name. Processes that have it open keep using it until they close it.
+     */
+    static void remove(const std::string& name) {
+#ifndef _WIN32
+        ::shm_unlink(name.c_str());
+#endif
+    };
+
+    /* Return a copy of frame \p frame of the file with fingerprint \p fingerprint, or an empty cv::Mat if it is not cached.
+     *
+     * @param[in] allocator The allocator for the returned image, or nullptr for OpenCV's default allocator.
+     */
+    cv::Mat get(std::uint64_t fingerprint, std::size_t frame, cv::MatAllocator* allocator = nullptr) {
+        const std::size_t first = first_slot(fingerprint, frame);
+        for (std::size_t way = 0; way < header->ways; ++way)
+        {
+            const std::size_t slot_index = (first + way) % header->slot_count;
+            Slot& slot = slots[slot_index];
+            const std::uint64_t sequence = load(slot.sequence, std::memory_order_acquire);
+            if (sequence == 0 || (sequence & 1) || load(slot.fingerprint) != fingerprint || load(slot.frame) != frame)
+                continue;
+
+            cv::Mat image;
+            image.allocator = allocator;
+            const auto rows = static_cast<int>(load(slot.rows)), cols = static_cast<int>(load(slot.cols)), type = static_cast<int>(load(slot.type));
+            const std::size_t size = std::size_t(rows) * cols * CV_ELEM_SIZE(type);
+            if (size > header->slot_size)
+                continue; // Torn read of a slot that is being rewritten, detected below anyway.
+            image.create(rows, cols, type);
+            std::memcpy(image.data, data + slot_index * header->slot_size, size);
+
+            // If a writer claimed the slot while we were copying, the copy may be torn:
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (load(slot.sequence) != sequence)
+                continue;
+            store(slot.last_used, std::atomic_ref<std::uint64_t>(header->clock).fetch_add(1, std::memory_order_relaxed));
+            ++hits;
+            return image;
+        }
+        ++misses;
+        return cv::Mat();
+    };
+
+    /* Store \p image as frame \p frame of the file with fingerprint \p fingerprint. Images that are not continuous or do
+     * not fit into a slot are not cached.
+     */
+    void put(std::uint64_t fingerprint, std::size_t frame, const cv::Mat& image) {
+        const std::size_t size = image.total() * image.elemSize();
+        if (image.empty() || !image.isContinuous() || size > header->slot_size)
+            return;
+
+        // Prefer the slot that already holds this frame, then an empty slot, then the least recently used one:
+        const std::size_t first = first_slot(fingerprint, frame);
+        std::size_t victim = first % header->slot_count;
+        std::uint64_t victim_last_used = std::numeric_limits<std::uint64_t>::max();
+        for (std::size_t way = 0; way < header->ways; ++way)
+        {
+            const std::size_t slot_index = (first + way) % header->slot_count;
+            Slot& slot = slots[slot_index];
+            const std::uint64_t sequence = load(slot.sequence);
+            if (sequence & 1)
+                continue;
+            if (sequence != 0 && load(slot.fingerprint) == fingerprint && load(slot.frame) == frame)
+                return;
+            const std::uint64_t last_used = sequence == 0 ? 0 : load(slot.last_used) + 1;
+            if (last_used < victim_last_used)
+            {
+                victim = slot_index;
+                victim_last_used = last_used;
+            }
+        }
+
+        Slot& slot = slots[victim];
+        std::uint64_t sequence = load(slot.sequence);
+        if ((sequence & 1) || !std::atomic_ref<std::uint64_t>(slot.sequence).compare_exchange_strong(sequence, sequence + 1, std::memory_order_acquire))
+        {
+            ++skipped_insertions;
+            return;
+        }
+        std::atomic_thread_fence(std::memory_order_release);
+
+        store(slot.fingerprint, fingerprint);
+        store(slot.frame, frame);
+        store(slot.rows, static_cast<std::uint64_t>(image.rows));
+        store(slot.cols, static_cast<std::uint64_t>(image.cols));
+        store(slot.type, static_cast<std::uint64_t>(image.type()));
+        std::memcpy(data + victim * header->slot_size, image.data, size);
+        store(slot.last_used, std::atomic_ref<std::uint64_t>(header->clock).fetch_add(1, std::memory_order_relaxed));
+
+        std::atomic_ref<std::uint64_t>(slot.sequence).store(sequence + 2, std::memory_order_release);
+        ++insertions;
+    };
+
+    /* Return this process's statistics for this cache object.
+     */
+    Stats get_stats() const {
+        return { hits.load(), misses.load(), insertions.load(), skipped_insertions.load() };
+    };
+
+    std::size_t get_slot_count() const {
+        return header->slot_count;
+    };
+
+    std::size_t get_slot_size() const {
+        return header->slot_size;
+    };
+
+    const std::string& get_name() const {
+        return name;
+    };
+
+private:
+    static constexpr std::uint64_t magic = 0x4d46424153484d31; // "MFBASHM1"
+    static constexpr std::uint64_t layout_version = 1;
+    static constexpr std::size_t page_size = 4096;
+
+    // All fields live in shared memory and are accessed through std::atomic_ref.
+    struct Header {
+        std::uint64_t magic;
+        std::uint64_t layout_version;
+        std::uint64_t slot_count;
+        std::uint64_t slot_size;
+        std::uint64_t ways;
+        std::uint64_t clock;
+    };
+
+    struct Slot {
+        std::uint64_t sequence; // 0: empty, odd: being written, even: valid.
+        std::uint64_t last_used;
+        std::uint64_t fingerprint;
+        std::uint64_t frame;
+        std::uint64_t rows;
+        std::uint64_t cols;
+        std::uint64_t type;
+        std::uint64_t reserved;
+    };
+
+    static_assert(std::atomic_ref<std::uint64_t>::is_always_lock_free, "shared memory atomics must be lock-free to be address-free");
+
+    std::string name;
+    std::byte* base = nullptr;
+    std::size_t mapped_size = 0;
+    Header* header = nullptr;
+    Slot* slots = nullptr;
+    std::byte* data = nullptr;
+    std::atomic<std::size_t> hits = 0, misses = 0, insertions = 0, skipped_insertions = 0;
+
+    static std::uint64_t load(std::uint64_t& field, std::memory_order order = std::memory_order_relaxed) {
+        return std::atomic_ref<std::uint64_t>(field).load(order);
+    };
+
+    static void store(std::uint64_t& field, std::uint64_t value) {
+        std::atomic_ref<std::uint64_t>(field).store(value, std::memory_order_relaxed);
+    };
+
+    std::size_t first_slot(std::uint64_t fingerprint, std::size_t frame) const {
+        std::uint64_t hash = fingerprint ^ (frame * 0x9E3779B97F4A7C15ull);
+        hash ^= hash >> 33;
+        hash *= 0xff51afd7ed558ccdull;
+        hash ^= hash >> 33;
+        return static_cast<std::size_t>(hash % header->slot_count);
+    };
+
+#ifndef _WIN32
+    /* Wait until the creator of the segment has sized it, and check that the size is the one we expect.
+     */
+    bool wait_for_size(int fd) const {
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        struct stat segment_status;
+        while (::fstat(fd, &segment_status) == 0)
+        {
+            if (segment_status.st_size != 0)
+                return static_cast<std::size_t>(segment_status.st_size) == mapped_size;
+            if (std::chrono::steady_clock::now() > deadline)
+                return false;
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        return false;
+    };
+#endif
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_SHARED_FRAME_CACHE_HPP */
@@ -0,0 +1,138 @@
+#pragma once
+
+#ifndef MIMETRIK_THREAD_POOL_HPP
+#define MIMETRIK_THREAD_POOL_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+namespace mimetrik {
+
+/* A fixed-size pool of worker threads that run submitted tasks in FIFO order.
+ *
+ * Used to decode, decompress and verify frames in parallel. Tasks must not block waiting on other tasks of the same pool,
+ * so parallel_for() should not be called from inside a task.
+ */
+class ThreadPool {
+
+public:
+    /* Construct a pool with \p num_threads workers (at least one).
+     *
+     * @param[in] num_threads The number of worker threads. Defaults to the number of hardware threads.
+     */
+    explicit ThreadPool(std::size_t num_threads = std::thread::hardware_concurrency()) {
+        num_threads = std::max<std::size_t>(num_threads, 1);
+        workers.reserve(num_threads);
+        for (std::size_t i = 0; i < num_threads; ++i)
+            workers.emplace_back([this] { run_worker(); });
+    };
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        task_available.notify_all();
+        for (auto& worker : workers)
+            worker.join();
+    };
+
+    /* Queue \p task for execution and return a future for its result.
+     *
+     * Exceptions thrown by the task are rethrown from std::future::get().
+     */
+    template <typename F>
+    auto submit(F&& task) -> std::future<std::invoke_result_t<std::decay_t<F>>> {
+        using result_type = std::invoke_result_t<std::decay_t<F>>;
+        std::packaged_task<result_type()> packaged_task(std::forward<F>(task));
+        auto result = packaged_task.get_future();
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            tasks.emplace(std::move(packaged_task));
+        }
+        task_available.notify_one();
+        return result;
+    };
+
+    /* Call \p body(i) for every i in [0, count) across the pool and wait for all calls to finish.
+     *
+     * The range is split into one contiguous chunk per worker. The first exception thrown by \p body is rethrown here, after
+     * all chunks have finished.
+     */
+    template <typename F>
+    void parallel_for(std::size_t count, F&& body) {
+        if (count == 0)
+            return;
+        const std::size_t num_chunks = std::min(count, workers.size());
+        const std::size_t chunk_size = (count + num_chunks - 1) / num_chunks;
+
+        std::vector<std::future<void>> chunks;
+        chunks.reserve(num_chunks);
+        for (std::size_t begin = 0; begin < count; begin += chunk_size)
+        {
+            const std::size_t end = std::min(begin + chunk_size, count);
+            chunks.push_back(submit([&body, begin, end] {
+                for (std::size_t i = begin; i < end; ++i)
+                    body(i);
+            }));
+        }
+
+        std::exception_ptr first_error;
+        for (auto& chunk : chunks)
+        {
+            try {
+                chunk.get();
+            }
+            catch (...) {
+                if (!first_error)
+                    first_error = std::current_exception();
+            }
+        }
+        if (first_error)
+            std::rethrow_exception(first_error);
+    };
+
+    std::size_t get_thread_count() const {
+        return workers.size();
+    };
+
+private:
+    std::vector<std::thread> workers;
+    std::queue<std::move_only_function<void()>> tasks;
+    std::mutex mutex;
+    std::condition_variable task_available;
+    bool stopping = false;
+
+    void run_worker() {
+        while (true)
+        {
+            std::move_only_function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                task_available.wait(lock, [this] { return stopping || !tasks.empty(); });
+                if (stopping && tasks.empty())
+                    return;
+                task = std::move(tasks.front());
+                tasks.pop();
+            }
+            task();
+        }
+    };
+};
+
+}; // namespace mimetrik
+
+#endif /* MIMETRIK_THREAD_POOL_HPP */
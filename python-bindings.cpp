@@ -6,6 +6,7 @@
 
 #include "pybind11_opencv.hpp"
 #include "mimetrik/FacebowFileReader.hpp"
+#include "mimetrik/SharedFacebowFileReader.hpp"
 
 namespace py = pybind11;
 
@@ -18,6 +19,59 @@ PYBIND11_MODULE(FacebowFileReader, m)
              "Construct a FacebowFileReader object for the given MFBA file.")
         .def("get_image_count", &mimetrik::FacebowFileReader::get_image_count,
              "Returns the number of images in the MFBA file.")
-        .def("get_image", &mimetrik::FacebowFileReader::get_image, "Doc")
-        .def("get_metadata", &mimetrik::FacebowFileReader::get_metadata, "Doc");
+        .def("get_image", py::overload_cast<std::size_t>(&mimetrik::FacebowFileReader::get_image), "Doc")
+        .def("get_metadata", &mimetrik::FacebowFileReader::get_metadata, "Doc")
+        .def("get_images", py::overload_cast<const std::vector<std::size_t>&>(&mimetrik::FacebowFileReader::get_images),
+             "Returns the images at the given indices, decoding only those frames.")
+        .def("get_timestamps", &mimetrik::FacebowFileReader::get_timestamps,
+             "Returns the sensor timestamp of every frame in nanoseconds.")
+        .def("find_frame_at", &mimetrik::FacebowFileReader::find_frame_at, py::arg("time"),
+             "Returns the index of the frame closest to the given time (seconds since the first frame).")
+        .def("find_frames_in_range", &mimetrik::FacebowFileReader::find_frames_in_range, py::arg("start_time"), py::arg("end_time"),
+             "Returns the indices of all frames in [start_time, end_time), in seconds since the first frame.")
+        .def("sample_frames_by_stride", &mimetrik::FacebowFileReader::sample_frames_by_stride, py::arg("stride"), py::arg("first_index") = 0,
+             "Returns every stride-th frame index.")
+        .def("sample_frames_at_fps", &mimetrik::FacebowFileReader::sample_frames_at_fps, py::arg("target_fps"),
+             "Returns the frame indices that resample the capture to the given frame rate.")
+        .def("write_thumbnails", [](const mimetrik::FacebowFileReader& reader) { reader.write_thumbnails(); }, py::call_guard<py::gil_scoped_release>(),
+             "Writes 1/4 and 1/16 size thumbnails of every frame to the <file>.thumbs sidecar.")
+        .def("get_thumbnail", &mimetrik::FacebowFileReader::get_thumbnail, py::arg("index"), py::arg("level"),
+             "Returns the thumbnail of the given frame from the sidecar: level 0 is 1/4 size, level 1 is 1/16 size.")
+        .def("get_frame_statistics", py::overload_cast<std::size_t>(&mimetrik::FacebowFileReader::get_frame_statistics, py::const_), py::arg("index"),
+             py::call_guard<py::gil_scoped_release>(),
+             "Returns the brightness, channel means, histograms and sharpness of the given frame, without decoding it into an image.");
+
+    py::class_<mimetrik::FrameStatistics>(m, "FrameStatistics")
+        .def_readonly("mean_brightness", &mimetrik::FrameStatistics::mean_brightness)
+        .def_readonly("channel_means", &mimetrik::FrameStatistics::channel_means)
+        .def_readonly("histograms", &mimetrik::FrameStatistics::histograms)
+        .def_readonly("sharpness", &mimetrik::FrameStatistics::sharpness);
+
+    py::class_<mimetrik::SharedFacebowFileReader>(m, "SharedFacebowFileReader")
+        .def(py::init<const std::filesystem::path&, const std::filesystem::path&>(), py::arg("filepath"), py::arg("index_file") = std::filesystem::path(),
+             "Construct a reader for DataLoader workers. The frame index is built once and shared read-only between processes; "
+             "the file is reopened lazily in every worker after fork or unpickling.")
+        .def("get_image_count", &mimetrik::SharedFacebowFileReader::get_image_count,
+             "Returns the number of images in the MFBA file.")
+        .def("get_image", &mimetrik::SharedFacebowFileReader::get_image, py::arg("index"), py::call_guard<py::gil_scoped_release>(),
+             "Returns the image at the given index.")
+        .def("get_images", &mimetrik::SharedFacebowFileReader::get_images, py::arg("indices"), py::call_guard<py::gil_scoped_release>(),
+             "Returns the images at the given indices.")
+        .def("get_metadata", &mimetrik::SharedFacebowFileReader::get_metadata, py::arg("index"),
+             "Returns the metadata of the image at the given index.")
+        .def("get_timestamps", &mimetrik::SharedFacebowFileReader::get_timestamps,
+             "Returns the sensor timestamp of every frame in nanoseconds.")
+        .def("get_filepath", &mimetrik::SharedFacebowFileReader::get_filepath)
+        .def("get_index_path", &mimetrik::SharedFacebowFileReader::get_index_path)
+        .def("__len__", &mimetrik::SharedFacebowFileReader::get_image_count)
+        .def(py::pickle(
+            [](const mimetrik::SharedFacebowFileReader& reader) {
+                return py::make_tuple(reader.get_filepath(), reader.get_index_path());
+            },
+            [](const py::tuple& state) {
+                if (state.size() != 2)
+                    throw std::runtime_error("Invalid SharedFacebowFileReader state");
+                // The index was built by the pickling process, the worker only opens it on first use:
+                return mimetrik::SharedFacebowFileReader(state[0].cast<std::filesystem::path>(), state[1].cast<std::filesystem::path>(), false);
+            }));
 }
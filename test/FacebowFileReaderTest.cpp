@@ -2,6 +2,91 @@
 #include <gtest/gtest.h>
 #include <gmock/gmock.h> // Unable to mock member functions due to not being declared as virtual - changing is outside the scope of the assessment
 #include <mimetrik/FacebowFileReader.hpp>
+#include <mimetrik/FrameBufferPool.hpp>
+#include <mimetrik/FrameStatistics.hpp>
+#include <mimetrik/MFBACatalog.hpp>
+#include <mimetrik/MFBATranscoder.hpp>
+#include <mimetrik/MFBAVerifier.hpp>
+#include <mimetrik/SharedFacebowFileReader.hpp>
+
+#ifndef _WIN32
+#include <sys/wait.h>
+#endif
+
+namespace {
+
+const std::size_t TEST_FRAME_BYTES = 1080 * 1920 * 3;
+
+// Expected (decoded) value of pixel byte i of frame f in the files written by write_test_mfba
+std::uint8_t test_pixel_value(std::size_t frame, std::size_t i)
+{
+    return static_cast<std::uint8_t>((frame * 31 + i) % 251);
+}
+
+// Write a synthetic MFBA 1.0.0 file with the given number of portrait frames, spaced frame_interval_ns apart.
+// The metadata of each frame holds the orientation and the sensor timestamp, like the real captures do.
+void write_test_mfba(const std::string& path, std::size_t num_frames, std::int64_t frame_interval_ns = 33'333'333)
+{
+    std::ofstream file(path, std::ios::binary);
+    const auto put_byte = [&file](std::uint8_t value) { file.put(static_cast<char>(value)); };
+    const auto put_uint32 = [&put_byte](std::uint32_t value) {
+        for (int shift = 24; shift >= 0; shift -= 8)
+            put_byte(static_cast<std::uint8_t>(value >> shift));
+    };
+
+    for (std::uint8_t byte : {0x46, 0x46, 0x46, 0x01, 0x00, 0x00})
+        put_byte(byte);
+    put_byte(static_cast<std::uint8_t>(num_frames >> 8));
+    put_byte(static_cast<std::uint8_t>(num_frames));
+
+    std::vector<char> pixels(TEST_FRAME_BYTES);
+    for (std::size_t frame = 0; frame < num_frames; ++frame)
+    {
+        const std::string metadata =
+            R"([{"metadataSource":"Orientation","contents":[{"key":"Orientation","value":"6"}]},)"
+            R"({"metadataSource":"CaptureResult","contents":[{"key":"android.sensor.timestamp","value":")" +
+            std::to_string(1'000'000'000 + static_cast<std::int64_t>(frame) * frame_interval_ns) + R"("}]}])";
+
+        put_uint32(12);
+        put_uint32(static_cast<std::uint32_t>(metadata.size()));
+        put_uint32(static_cast<std::uint32_t>(TEST_FRAME_BYTES));
+        for (char c : metadata)
+            put_byte(static_cast<std::uint8_t>(c) ^ 0xFF);
+        for (std::size_t i = 0; i < TEST_FRAME_BYTES; ++i)
+            pixels[i] = static_cast<char>(test_pixel_value(frame, i) ^ 0xFF);
+        file.write(pixels.data(), pixels.size());
+    }
+}
+
+
+// A fresh directory under ::testing::TempDir() for the (multi-MB) files a test writes, removed again when the test ends,
+// including when an assertion fails.
+class TestDirectory {
+public:
+    TestDirectory() {
+        const auto* test = ::testing::UnitTest::GetInstance()->current_test_info();
+        directory = std::filesystem::path(::testing::TempDir()) / ("mimetrik_" + std::string(test->test_suite_name()) + "_" + test->name());
+        std::filesystem::remove_all(directory);
+        std::filesystem::create_directories(directory);
+    }
+
+    ~TestDirectory() {
+        std::error_code error;
+        std::filesystem::remove_all(directory, error);
+    }
+
+    TestDirectory(const TestDirectory&) = delete;
+    TestDirectory& operator=(const TestDirectory&) = delete;
+
+    const std::filesystem::path& get_path() const { return directory; }
+
+    std::string path(const std::string& filename) const { return (directory / filename).string(); }
+
+private:
+    std::filesystem::path directory;
+};
+
+} // namespace
 
 TEST(FacebowFileReaderTest, FailOnEmptyFile)
 {
@@ -73,12 +158,28 @@ TEST(FacebowFileReaderTest, FailOnInvalidVersion)
         mimetrik::FacebowFileReader("test_video_invalid_version.mfba");
     }
     catch(std::runtime_error &e)
-    {  // Should arrive here due to the version number not being 1.0.0
+    {  // Should arrive here due to the version number not being a supported one
         error = e.what();
     }
 
     // Testing outside of the catch as the assertion would not be made if the catch was not triggered
-    EXPECT_EQ(error, "test_video_invalid_version.mfba: MFBA version is not 1.0.0");
+#ifndef MIMETRIK_NO_ZSTD
+    EXPECT_EQ(error, "test_video_invalid_version.mfba: MFBA version is not 1.0.0, 1.1.0 or 1.2.0");
+#else
+    EXPECT_EQ(error, "test_video_invalid_version.mfba: MFBA version is not 1.0.0 or 1.2.0");
+#endif
+
+    // The catalog rejects the file with the same message as the reader
+    std::string catalog_error = "";
+    try
+    {
+        mimetrik::MFBACatalog catalog(std::vector<std::filesystem::path>{ "test_video_invalid_version.mfba" });
+    }
+    catch(std::runtime_error &e)
+    {
+        catalog_error = e.what();
+    }
+    EXPECT_EQ(catalog_error, error);
 }
 
 TEST(FacebowFileReaderTest, FileHeadersAreValid)
@@ -351,6 +452,576 @@ TEST(FacebowFileReaderTest, FrameLatencyIsAdequate)
     //EXPECT_GT(frameRate, 20.0); // Expect at least 20fps
 }
 
+TEST(FacebowFileReaderTest, TemporalQueriesUseTimestamps)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_10fps.mfba");
+    write_test_mfba(VIDEO_PATH, 4, 100'000'000); // 4 frames at 10fps: t = 0.0, 0.1, 0.2, 0.3 seconds
+
+    mimetrik::FacebowFileReader reader(VIDEO_PATH);
+
+    const auto& timestamps = reader.get_timestamps();
+    ASSERT_EQ(timestamps.size(), 4);
+    EXPECT_EQ(timestamps[0], 1'000'000'000);
+    EXPECT_EQ(timestamps[3], 1'300'000'000);
+
+    EXPECT_EQ(reader.find_frame_at(0.21), 2);
+    EXPECT_EQ(reader.find_frame_at(-1.0), 0);
+    EXPECT_EQ(reader.find_frame_at(5.0), 3);
+    EXPECT_EQ(reader.find_frames_in_range(0.1, 0.3), std::vector<std::size_t>({1, 2}));
+    EXPECT_EQ(reader.sample_frames_by_stride(3), std::vector<std::size_t>({0, 3}));
+    EXPECT_EQ(reader.sample_frames_at_fps(5.0), std::vector<std::size_t>({0, 2}));
+    EXPECT_EQ(reader.sample_frames_at_fps(30.0), std::vector<std::size_t>({0, 1, 2, 3}));
+
+    const auto images = reader.get_images(reader.sample_frames_at_fps(5.0));
+    ASSERT_EQ(images.size(), 2);
+    EXPECT_EQ(images[1].at<cv::Vec3b>(0, 0)[0], test_pixel_value(2, 0));
+
+    // Absurd rates return every frame without iterating over the ticks, non-finite ones are rejected
+    EXPECT_EQ(reader.sample_frames_at_fps(1e300), std::vector<std::size_t>({0, 1, 2, 3}));
+    EXPECT_THROW(reader.sample_frames_at_fps(std::numeric_limits<double>::infinity()), std::runtime_error);
+
+    // Timestamps out of capture order cannot be binary-searched, so temporal queries refuse them
+    const std::string UNORDERED_PATH = test_directory.path("test_video_unordered.mfba");
+    write_test_mfba(UNORDERED_PATH, 3, -100'000'000);
+    mimetrik::FacebowFileReader unordered(UNORDERED_PATH);
+    EXPECT_EQ(unordered.get_timestamps()[2], 800'000'000);
+    EXPECT_THROW(unordered.find_frame_at(0.1), std::runtime_error);
+    EXPECT_THROW(unordered.sample_frames_at_fps(5.0), std::runtime_error);
+
+    // A timestamp object that is never closed is still read safely, up to the end of the metadata
+    const std::string UNCLOSED_PATH = test_directory.path("test_video_unclosed_metadata.mfba");
+    {
+        const std::string metadata = R"([{"metadataSource":"CaptureResult","contents":[{"key":"android.sensor.timestamp","value":"123)";
+        std::ofstream file(UNCLOSED_PATH, std::ios::binary);
+        file.write("FFF\x01\x00\x00\x00\x01", 8);
+        for (const std::uint32_t value : { std::uint32_t(12), static_cast<std::uint32_t>(metadata.size()), static_cast<std::uint32_t>(TEST_FRAME_BYTES) })
+            for (int shift = 24; shift >= 0; shift -= 8)
+                file.put(static_cast<char>(value >> shift));
+        for (char c : metadata)
+            file.put(static_cast<char>(c ^ 0xFF));
+        file.write(std::string(TEST_FRAME_BYTES, '\0').data(), TEST_FRAME_BYTES);
+    }
+    EXPECT_EQ(mimetrik::FacebowFileReader(UNCLOSED_PATH).get_timestamps()[0], 123);
+}
+
+TEST(FacebowFileReaderTest, CompressedVersionRoundTrips)
+{
+#ifdef MIMETRIK_NO_ZSTD
+    GTEST_SKIP() << "built without zstd";
+#endif
+    const TestDirectory test_directory;
+    const std::string RAW_PATH = test_directory.path("test_video_raw.mfba"), COMPRESSED_PATH = test_directory.path("test_video_compressed.mfba"), ROUND_TRIP_PATH = test_directory.path("test_video_round_trip.mfba");
+    write_test_mfba(RAW_PATH, 3);
+
+    mimetrik::transcode_mfba(RAW_PATH, COMPRESSED_PATH, mimetrik::mfba_version_compressed);
+    mimetrik::transcode_mfba(COMPRESSED_PATH, ROUND_TRIP_PATH, mimetrik::mfba_version_raw);
+
+    mimetrik::FacebowFileReader raw(RAW_PATH), compressed(COMPRESSED_PATH);
+    EXPECT_EQ(compressed.get_version(), mimetrik::mfba_version_compressed);
+    EXPECT_EQ(compressed.get_image_count(), 3);
+    EXPECT_LT(std::filesystem::file_size(COMPRESSED_PATH), std::filesystem::file_size(RAW_PATH) / 2);
+    EXPECT_EQ(compressed.get_metadata(2), raw.get_metadata(2));
+
+    // Decompressing in parallel must give the same pixels as reading the raw file
+    mimetrik::ThreadPool pool(2);
+    const auto images = compressed.get_images({0, 1, 2}, pool);
+    for (std::size_t frame = 0; frame < 3; ++frame)
+        EXPECT_EQ(compressed.read_image_block(frame), raw.read_image_block(frame));
+    EXPECT_EQ(images[2].at<cv::Vec3b>(1919, 1079)[2], test_pixel_value(2, TEST_FRAME_BYTES - 1));
+
+    // 1.0.0 -> 1.1.0 -> 1.0.0 reproduces the original file byte for byte
+    std::ifstream original(RAW_PATH, std::ios::binary), round_trip(ROUND_TRIP_PATH, std::ios::binary);
+    EXPECT_TRUE(std::equal(std::istreambuf_iterator<char>(original), std::istreambuf_iterator<char>(), std::istreambuf_iterator<char>(round_trip)));
+
+    // A transcode that fails part way through leaves an existing output file untouched and no temporary file behind
+    const auto& last_frame = compressed.get_frame_location_info()[2];
+    {
+        std::fstream damaged(COMPRESSED_PATH, std::ios::in | std::ios::out | std::ios::binary);
+        damaged.seekp(last_frame.frame_index + last_frame.offset_to_header + last_frame.offset_to_image);
+        damaged.write("\0\0\0\0", 4); // The zstd frame magic
+    }
+    const auto round_trip_size = std::filesystem::file_size(ROUND_TRIP_PATH);
+    EXPECT_THROW(mimetrik::transcode_mfba(COMPRESSED_PATH, ROUND_TRIP_PATH, mimetrik::mfba_version_raw, 3, 1), std::runtime_error);
+    EXPECT_EQ(std::filesystem::file_size(ROUND_TRIP_PATH), round_trip_size);
+    for (const auto& entry : std::filesystem::directory_iterator(test_directory.get_path()))
+        EXPECT_EQ(entry.path().string().find(ROUND_TRIP_PATH + ".tmp"), std::string::npos);
+}
+
+TEST(FacebowFileReaderTest, HotLayoutIsServedZeroCopy)
+{
+    const TestDirectory test_directory;
+    const std::string RAW_PATH = test_directory.path("test_video_raw_for_hot.mfba"), HOT_PATH = test_directory.path("test_video_hot.mfba"), BACK_PATH = test_directory.path("test_video_from_hot.mfba");
+    write_test_mfba(RAW_PATH, 2);
+    mimetrik::repack_mfba_hot(RAW_PATH, HOT_PATH);
+
+    mimetrik::FacebowFileReader raw(RAW_PATH), hot(HOT_PATH);
+    ASSERT_TRUE(hot.is_memory_mapped());
+    EXPECT_FALSE(raw.is_memory_mapped());
+    EXPECT_EQ(hot.get_version(), mimetrik::mfba_version_hot);
+    EXPECT_EQ(hot.get_image_count(), 2);
+    EXPECT_EQ(hot.get_metadata(1), raw.get_metadata(1));
+    EXPECT_EQ(hot.get_timestamps(), raw.get_timestamps());
+
+    // The image points into the mapping: page-aligned, and the same pixels every time without any copy
+    const cv::Mat image = hot.get_image(1);
+    EXPECT_EQ(reinterpret_cast<std::uintptr_t>(image.data) % 4096, 0);
+    EXPECT_EQ(hot.get_image(1).data, image.data);
+    EXPECT_EQ(image.rows, 1920);
+    EXPECT_EQ(image.cols, 1080);
+    EXPECT_EQ(image.at<cv::Vec3b>(7, 3)[2], raw.get_image(1).at<cv::Vec3b>(7, 3)[2]);
+
+    // The image keeps the mapping alive after its reader is gone, and writing to it never touches the file
+    cv::Mat outliving;
+    {
+        mimetrik::FacebowFileReader short_lived(HOT_PATH);
+        outliving = short_lived.get_image(0);
+    }
+    EXPECT_EQ(outliving.at<cv::Vec3b>(1919, 1079)[2], raw.get_image(0).at<cv::Vec3b>(1919, 1079)[2]);
+    outliving.at<cv::Vec3b>(0, 0)[0] ^= 0xFF;
+    EXPECT_EQ(mimetrik::FacebowFileReader(HOT_PATH).get_image(0).at<cv::Vec3b>(0, 0)[0], raw.get_image(0).at<cv::Vec3b>(0, 0)[0]);
+    outliving.release();
+
+    // Hot files can be transcoded back to the interchange format
+    mimetrik::transcode_mfba(HOT_PATH, BACK_PATH, mimetrik::mfba_version_raw);
+    mimetrik::FacebowFileReader back(BACK_PATH);
+    EXPECT_EQ(back.read_image_block(1), raw.read_image_block(1));
+    EXPECT_EQ(back.get_metadata(0), raw.get_metadata(0));
+
+    // A capture without frames repacks into a header and a trailer, which the reader accepts
+    write_test_mfba(RAW_PATH, 0);
+    mimetrik::repack_mfba_hot(RAW_PATH, HOT_PATH);
+    EXPECT_EQ(std::filesystem::file_size(HOT_PATH), 32);
+    EXPECT_EQ(mimetrik::FacebowFileReader(HOT_PATH).get_image_count(), 0);
+    write_test_mfba(RAW_PATH, 2);
+    mimetrik::repack_mfba_hot(RAW_PATH, HOT_PATH);
+
+    // A repack that fails part way through, here on the orientation of the last frame, leaves the existing hot file intact
+    {
+        std::ifstream input(RAW_PATH, std::ios::binary);
+        std::string contents((std::istreambuf_iterator<char>(input)), std::istreambuf_iterator<char>());
+        std::string orientation = R"("value":"6")";
+        for (char& c : orientation)
+            c = static_cast<char>(c ^ 0xFF);
+        const auto position = contents.rfind(orientation);
+        ASSERT_NE(position, std::string::npos);
+        contents[position + orientation.size() - 2] = static_cast<char>('x' ^ 0xFF);
+        std::ofstream(RAW_PATH, std::ios::binary).write(contents.data(), contents.size());
+    }
+    const auto hot_size = std::filesystem::file_size(HOT_PATH);
+    EXPECT_ANY_THROW(mimetrik::repack_mfba_hot(RAW_PATH, HOT_PATH, 1));
+    EXPECT_EQ(std::filesystem::file_size(HOT_PATH), hot_size);
+    EXPECT_EQ(mimetrik::FacebowFileReader(HOT_PATH).get_image_count(), 2);
+}
+
+TEST(FacebowFileReaderTest, FrameBufferPoolRecyclesBuffers)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_pool.mfba");
+    write_test_mfba(VIDEO_PATH, 2);
+
+    mimetrik::FrameBufferPool pool;
+    mimetrik::FacebowFileReader reader(VIDEO_PATH);
+    reader.set_mat_allocator(&pool);
+
+    cv::Mat image = reader.get_image(0);
+    EXPECT_EQ(pool.get_stats().misses, 1);
+    EXPECT_EQ(pool.get_stats().outstanding, 1);
+    EXPECT_EQ(image.at<cv::Vec3b>(0, 1)[0], test_pixel_value(0, 3));
+    const auto* first_buffer = image.data;
+
+    // Releasing the frame returns its buffer to the pool, and the next frame reuses it
+    image.release();
+    EXPECT_EQ(pool.get_stats().outstanding, 0);
+    EXPECT_EQ(pool.get_stats().pooled, 1);
+    image = reader.get_image(1);
+    EXPECT_EQ(image.data, first_buffer);
+    EXPECT_EQ(image.at<cv::Vec3b>(0, 1)[0], test_pixel_value(1, 3));
+
+    const auto stats = pool.get_stats();
+    EXPECT_EQ(stats.hits, 1);
+    EXPECT_EQ(stats.misses, 1);
+    EXPECT_EQ(stats.outstanding, 1);
+    EXPECT_EQ(stats.pooled, 0);
+
+    // Buffers are rounded up to whole huge pages, or to 4 KiB pages without them
+    EXPECT_EQ(stats.buffer_footprint, 6u * 1024 * 1024);
+    EXPECT_EQ(mimetrik::FrameBufferPool(TEST_FRAME_BYTES, 1, false).get_stats().buffer_footprint, 6'221'824u);
+}
+
+TEST(FacebowFileReaderTest, IOPoliciesReadIdenticalBytes)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_io_policy.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+
+    mimetrik::FacebowFileReader reader(VIDEO_PATH);
+    const auto metadata = reader.get_metadata(1);
+    const auto image_block = reader.read_image_block(2);
+
+    for (const auto policy : { mimetrik::IOPolicy::sequential, mimetrik::IOPolicy::random, mimetrik::IOPolicy::direct })
+    {
+        reader.set_io_policy(policy, 1024 * 1024);
+        EXPECT_EQ(reader.get_io_policy(), policy);
+        // Direct reads of unaligned ranges go through an aligned bounce buffer
+        EXPECT_EQ(reader.get_metadata(1), metadata) << mimetrik::to_string(policy);
+        EXPECT_EQ(reader.read_image_block(2), image_block) << mimetrik::to_string(policy);
+    }
+
+    // A sequential pass never goes back to pages the policy already dropped, not even for a frame's metadata
+    const std::string SEQUENTIAL_PATH = test_directory.path("test_video_io_policy_sequential.mfba");
+    write_test_mfba(SEQUENTIAL_PATH, 4);
+    mimetrik::FacebowFileReader sequential_reader(SEQUENTIAL_PATH);
+    sequential_reader.set_io_policy(mimetrik::IOPolicy::sequential, 1024 * 1024);
+    for (std::size_t frame = 0; frame < 4; ++frame)
+    {
+        sequential_reader.get_image(frame);
+        sequential_reader.get_frame_statistics(frame);
+    }
+    EXPECT_EQ(sequential_reader.get_io_reread_count(), 0u);
+    sequential_reader.get_metadata(0);
+    EXPECT_EQ(sequential_reader.get_io_reread_count(), 1u);
+
+    reader.set_io_policy(mimetrik::IOPolicy::standard);
+    EXPECT_EQ(reader.get_io_policy(), mimetrik::IOPolicy::standard);
+    EXPECT_EQ(mimetrik::parse_io_policy("direct"), mimetrik::IOPolicy::direct);
+    EXPECT_THROW(mimetrik::parse_io_policy("fast"), std::runtime_error);
+}
+
+TEST(FacebowFileReaderTest, SharedReaderBuildsFrameIndexOnce)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_shared.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+    std::filesystem::remove(mimetrik::get_frame_index_path(VIDEO_PATH));
+
+    mimetrik::SharedFacebowFileReader shared(VIDEO_PATH);
+    ASSERT_TRUE(std::filesystem::exists(shared.get_index_path()));
+    const auto index_time = std::filesystem::last_write_time(shared.get_index_path());
+
+    // A reader from the mapped index sees the same frame table as one that sweeps the file
+    const mimetrik::FacebowFileReader scanned(VIDEO_PATH);
+    const mimetrik::FacebowFileReader indexed(VIDEO_PATH, nullptr, std::make_shared<const mimetrik::MappedFile>(shared.get_index_path()));
+    ASSERT_EQ(indexed.get_frame_location_info().size(), 3);
+    EXPECT_EQ(indexed.get_frame_location_info()[2].frame_index, scanned.get_frame_location_info()[2].frame_index);
+    EXPECT_EQ(indexed.get_metadata(2), scanned.get_metadata(2));
+
+    // A second instance, e.g. an unpickled copy, reuses the index instead of rebuilding it
+    mimetrik::SharedFacebowFileReader copy(shared.get_filepath(), shared.get_index_path(), false);
+    EXPECT_EQ(copy.get_image_count(), 3);
+    EXPECT_EQ(std::filesystem::last_write_time(shared.get_index_path()), index_time);
+
+#ifndef _WIN32
+    // A forked worker reopens the file on first use and reads the same pixels
+    EXPECT_EQ(shared.get_image(1).at<cv::Vec3b>(0, 1)[0], test_pixel_value(1, 3));
+    const pid_t child = fork();
+    ASSERT_NE(child, -1);
+    if (child == 0)
+        _exit(shared.get_image(2).at<cv::Vec3b>(0, 1)[0] == test_pixel_value(2, 3) ? 0 : 1);
+    int status = 0;
+    waitpid(child, &status, 0);
+    EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+#endif
+
+    // An index with a damaged entry is rejected, and the shared reader falls back to rebuilding it
+    {
+        std::fstream index_file(shared.get_index_path(), std::ios::in | std::ios::out | std::ios::binary);
+        const std::uint32_t bad_image_size = 12345;
+        index_file.seekp(64 + sizeof(mimetrik::FacebowFileReader::FrameLocationInfo) + offsetof(mimetrik::FacebowFileReader::FrameLocationInfo, image_size));
+        index_file.write(reinterpret_cast<const char*>(&bad_image_size), sizeof(bad_image_size));
+    }
+    EXPECT_THROW(mimetrik::FacebowFileReader(VIDEO_PATH, nullptr, std::make_shared<const mimetrik::MappedFile>(shared.get_index_path())), std::runtime_error);
+    EXPECT_EQ(mimetrik::SharedFacebowFileReader(VIDEO_PATH).get_image(1).at<cv::Vec3b>(0, 1)[0], test_pixel_value(1, 3));
+    EXPECT_NO_THROW(mimetrik::FacebowFileReader(VIDEO_PATH, nullptr, std::make_shared<const mimetrik::MappedFile>(shared.get_index_path())));
+
+    // An index no longer matches once the file is rewritten
+    write_test_mfba(VIDEO_PATH, 2);
+    std::filesystem::last_write_time(VIDEO_PATH, index_time + std::chrono::seconds(1));
+    EXPECT_THROW(mimetrik::FacebowFileReader(VIDEO_PATH, nullptr, std::make_shared<const mimetrik::MappedFile>(shared.get_index_path())), std::runtime_error);
+    EXPECT_EQ(mimetrik::SharedFacebowFileReader(VIDEO_PATH).get_image_count(), 2);
+}
+
+TEST(FacebowFileReaderTest, FrameStatisticsAreFusedIntoDecode)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_statistics.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+
+    mimetrik::FacebowFileReader reader(VIDEO_PATH);
+    mimetrik::FrameStatistics fused;
+    const auto image = reader.get_image(1, fused);
+    EXPECT_EQ(image.at<cv::Vec3b>(1919, 1079)[2], test_pixel_value(1, TEST_FRAME_BYTES - 1));
+
+    // Fused, stats-only and after-the-fact statistics agree
+    const auto after = mimetrik::compute_frame_statistics(image);
+    const auto stats_only = reader.get_frame_statistics(1);
+    EXPECT_EQ(fused.histograms, after.histograms);
+    EXPECT_EQ(stats_only.histograms, after.histograms);
+    EXPECT_DOUBLE_EQ(fused.mean_brightness, after.mean_brightness);
+    EXPECT_DOUBLE_EQ(stats_only.sharpness, after.sharpness);
+    std::size_t blue_count = 0, blue_sum = 0;
+    for (std::size_t value = 0; value < 256; ++value)
+    {
+        blue_count += fused.histograms[0][value];
+        blue_sum += value * fused.histograms[0][value];
+    }
+    EXPECT_EQ(blue_count, 1920 * 1080);
+    EXPECT_DOUBLE_EQ(fused.channel_means[0], blue_sum / (1920.0 * 1080.0));
+    EXPECT_GT(fused.sharpness, 0);
+
+    mimetrik::ThreadPool pool(2);
+    EXPECT_EQ(reader.get_frame_statistics({ 2, 1 }, pool)[1].histograms, fused.histograms);
+
+    // A flat image has no edges
+    const auto flat = mimetrik::compute_frame_statistics(cv::Mat(8, 8, CV_8UC3, cv::Scalar(10, 20, 30)));
+    EXPECT_DOUBLE_EQ(flat.channel_means[2], 30);
+    EXPECT_DOUBLE_EQ(flat.mean_brightness, 22); // (29 * 10 + 150 * 20 + 77 * 30 + 128) / 256
+    EXPECT_DOUBLE_EQ(flat.sharpness, 0);
+}
+
+TEST(FacebowFileReaderTest, ThumbnailsAreBoxAveragesFromTheSidecar)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_thumbnails.mfba"), HOT_PATH = test_directory.path("test_video_thumbnails_hot.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+    mimetrik::repack_mfba_hot(VIDEO_PATH, HOT_PATH);
+
+    mimetrik::ThreadPool pool(2);
+    mimetrik::FacebowFileReader reader(VIDEO_PATH);
+    EXPECT_THROW(reader.get_thumbnail(0, 0), std::runtime_error); // No sidecar yet
+    reader.write_thumbnails(pool);
+
+    const auto quarter = reader.get_thumbnail(2, 0);
+    ASSERT_EQ(quarter.rows, 480);
+    ASSERT_EQ(quarter.cols, 270);
+    const auto sixteenth = reader.get_thumbnail(2, 1);
+    ASSERT_EQ(sixteenth.rows, 120);
+    ASSERT_EQ(sixteenth.cols, 67);
+
+    // Each thumbnail pixel is the rounded mean of the full-size box it covers
+    const auto box_mean = [](std::size_t frame, int row, int col, int channel, int factor) {
+        std::size_t sum = 0;
+        for (int r = row * factor; r < (row + 1) * factor; ++r)
+            for (int c = col * factor; c < (col + 1) * factor; ++c)
+                sum += test_pixel_value(frame, (std::size_t(r) * 1080 + c) * 3 + channel);
+        return static_cast<std::uint8_t>((sum + factor * factor / 2) / (factor * factor));
+    };
+    EXPECT_EQ(quarter.at<cv::Vec3b>(0, 0)[0], box_mean(2, 0, 0, 0, 4));
+    EXPECT_EQ(quarter.at<cv::Vec3b>(479, 269)[2], box_mean(2, 479, 269, 2, 4));
+    EXPECT_EQ(sixteenth.at<cv::Vec3b>(119, 66)[1], box_mean(2, 119, 66, 1, 16));
+
+    // Hot files produce the same thumbnails from their plain pixels
+    mimetrik::FacebowFileReader hot(HOT_PATH);
+    hot.write_thumbnails(pool);
+    EXPECT_EQ(hot.get_thumbnail(2, 1).at<cv::Vec3b>(119, 66)[1], sixteenth.at<cv::Vec3b>(119, 66)[1]);
+
+    // Thumbnails outlive their reader and a reload of the sidecar, and writing to them never reaches the sidecar
+    cv::Mat outliving;
+    {
+        mimetrik::FacebowFileReader short_lived(VIDEO_PATH);
+        outliving = short_lived.get_thumbnail(1, 0);
+        short_lived.load_thumbnails();
+    }
+    reader.load_thumbnails();
+    EXPECT_EQ(outliving.at<cv::Vec3b>(479, 269)[2], box_mean(1, 479, 269, 2, 4));
+    outliving.at<cv::Vec3b>(0, 0)[0] ^= 0xFF;
+    EXPECT_EQ(mimetrik::FacebowFileReader(VIDEO_PATH).get_thumbnail(1, 0).at<cv::Vec3b>(0, 0)[0], box_mean(1, 0, 0, 0, 4));
+    EXPECT_EQ(quarter.at<cv::Vec3b>(0, 0)[0], box_mean(2, 0, 0, 0, 4));
+
+    // A sidecar written for an earlier version of the file is rejected
+    write_test_mfba(VIDEO_PATH, 2);
+    EXPECT_THROW(mimetrik::FacebowFileReader(VIDEO_PATH).get_thumbnail(0, 0), std::runtime_error);
+}
+
+#ifndef _WIN32
+TEST(FacebowFileReaderTest, SharedFrameCacheServesOtherProcesses)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_shared_cache.mfba"), CACHE_NAME = "/mimetrik-test-frame-cache-" + std::to_string(getpid());
+    write_test_mfba(VIDEO_PATH, 3);
+    const std::size_t capacity = 4 * 6225920; // Four page-aligned frame slots
+
+    // A child process decodes frame 1 into the cache
+    const pid_t child = fork();
+    ASSERT_NE(child, -1);
+    if (child == 0)
+    {
+        mimetrik::FacebowFileReader producer(VIDEO_PATH);
+        producer.set_shared_frame_cache(std::make_shared<mimetrik::SharedFrameCache>(CACHE_NAME, capacity));
+        producer.get_image(1);
+        _exit(0);
+    }
+    int status = 0;
+    waitpid(child, &status, 0);
+    ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+    // This process finds it there instead of decoding it again
+    auto cache = std::make_shared<mimetrik::SharedFrameCache>(CACHE_NAME, capacity);
+    mimetrik::SharedFrameCache::remove(CACHE_NAME);
+    EXPECT_EQ(cache->get_slot_count(), 4);
+    mimetrik::FacebowFileReader consumer(VIDEO_PATH);
+    consumer.set_shared_frame_cache(cache);
+    const auto image = consumer.get_image(1);
+    EXPECT_EQ(cache->get_stats().hits, 1);
+    EXPECT_EQ(image.rows, 1920);
+    EXPECT_EQ(image.at<cv::Vec3b>(1919, 1079)[2], test_pixel_value(1, TEST_FRAME_BYTES - 1));
+
+    consumer.get_image(2);
+    EXPECT_EQ(cache->get_stats().misses, 1);
+    EXPECT_EQ(cache->get_stats().insertions, 1);
+
+    // A rewritten file has a new fingerprint and never hits the old frames
+    const auto fingerprint = mimetrik::get_file_fingerprint(VIDEO_PATH);
+    write_test_mfba(VIDEO_PATH, 3, 50'000'000);
+    std::filesystem::last_write_time(VIDEO_PATH, std::filesystem::last_write_time(VIDEO_PATH) + std::chrono::seconds(1));
+    EXPECT_NE(mimetrik::get_file_fingerprint(VIDEO_PATH), fingerprint);
+    mimetrik::FacebowFileReader rewritten(VIDEO_PATH);
+    rewritten.set_shared_frame_cache(cache);
+    rewritten.get_image(1);
+    EXPECT_EQ(cache->get_stats().hits, 1);
+}
+#endif
+
+TEST(MFBAVerifierTest, CRC32CMatchesReferenceValue)
+{
+    const std::string CHECK_INPUT = "123456789";
+    const auto* data = reinterpret_cast<const std::byte*>(CHECK_INPUT.data());
+
+    EXPECT_EQ(mimetrik::crc32c(0, data, CHECK_INPUT.size()), 0xE3069283u); // The standard CRC-32C check value
+    EXPECT_EQ(mimetrik::crc32c(mimetrik::crc32c(0, data, 4), data + 4, 5), 0xE3069283u); // Chunked computation gives the same result
+    EXPECT_EQ(~mimetrik::detail::crc32c_software(~0u, data, CHECK_INPUT.size()), 0xE3069283u);
+}
+
+TEST(MFBAVerifierTest, DetectsCorruptionAndTruncation)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_verify.mfba"), TRUNCATED_PATH = test_directory.path("test_video_truncated.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+    std::filesystem::remove(mimetrik::get_checksum_sidecar_path(VIDEO_PATH));
+
+    mimetrik::MFBAVerifyOptions options;
+    options.update_sidecar = true;
+    auto report = mimetrik::verify_mfba(VIDEO_PATH, options);
+    EXPECT_TRUE(report.is_ok());
+    EXPECT_FALSE(report.sidecar_found);
+    EXPECT_EQ(report.num_valid_frames, 3);
+    ASSERT_TRUE(report.checksums[2].has_value());
+    EXPECT_TRUE(std::filesystem::exists(mimetrik::get_checksum_sidecar_path(VIDEO_PATH)));
+    for (const auto& entry : std::filesystem::directory_iterator(test_directory.get_path()))
+        EXPECT_EQ(entry.path().string().find(VIDEO_PATH + ".crc32c.json.tmp"), std::string::npos); // Written via rename
+
+    // Flip one pixel byte of frame 1: the structure is still fine, but the checksum no longer matches the sidecar
+    const std::size_t frame_1_pixel = mimetrik::FacebowFileReader(VIDEO_PATH).get_frame_location_info()[1].frame_index + 5000;
+    {
+        std::fstream file(VIDEO_PATH, std::ios::binary | std::ios::in | std::ios::out);
+        file.seekp(frame_1_pixel);
+        file.put('\x00');
+    }
+    report = mimetrik::verify_mfba(VIDEO_PATH);
+    EXPECT_TRUE(report.sidecar_found);
+    EXPECT_FALSE(report.structural_error.has_value());
+    EXPECT_EQ(report.checksum_mismatches, std::vector<std::size_t>({1}));
+
+    // Cut the file in the middle of frame 2: both the verifier and the reader report the bad frame up front
+    std::filesystem::copy_file(VIDEO_PATH, TRUNCATED_PATH, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(TRUNCATED_PATH, std::filesystem::file_size(VIDEO_PATH) - 1000);
+    report = mimetrik::verify_mfba(TRUNCATED_PATH);
+    ASSERT_TRUE(report.structural_error.has_value());
+    EXPECT_EQ(report.num_valid_frames, 2);
+    EXPECT_THAT(report.structural_error.value(), testing::StartsWith("frame 2 at byte"));
+    EXPECT_THROW(mimetrik::FacebowFileReader reader(TRUNCATED_PATH), std::runtime_error);
+
+    // Append to the file: the sidecar now describes a different file, which is reported on its own
+    const auto recorded_size = std::filesystem::file_size(VIDEO_PATH);
+    std::ofstream(VIDEO_PATH, std::ios::binary | std::ios::app) << "trailing bytes";
+    report = mimetrik::verify_mfba(VIDEO_PATH);
+    EXPECT_FALSE(report.is_ok());
+    EXPECT_FALSE(report.structural_error.has_value());
+    EXPECT_EQ(report.sidecar_file_size_mismatch, std::optional<std::size_t>(recorded_size));
+    EXPECT_TRUE(report.checksum_mismatches.empty());
+}
+
+TEST(FacebowFileReaderTest, OpenReportsAndSalvagesDamagedFiles)
+{
+    const TestDirectory test_directory;
+    const std::string VIDEO_PATH = test_directory.path("test_video_open.mfba"), TRUNCATED_PATH = test_directory.path("test_video_open_truncated.mfba"), GARBAGE_PATH = test_directory.path("test_video_open_garbage.mfba");
+    write_test_mfba(VIDEO_PATH, 3);
+    std::filesystem::copy_file(VIDEO_PATH, TRUNCATED_PATH, std::filesystem::copy_options::overwrite_existing);
+    std::filesystem::resize_file(TRUNCATED_PATH, std::filesystem::file_size(VIDEO_PATH) - 1000);
+    std::ofstream(GARBAGE_PATH, std::ios::binary) << "not an MFBA file";
+
+    // Triage all files in parallel, none of them throws:
+    const std::vector<std::string> paths = { VIDEO_PATH, TRUNCATED_PATH, GARBAGE_PATH, "does_not_exist.mfba" };
+    std::vector<std::optional<mimetrik::MFBAOpenError>> errors(paths.size());
+    mimetrik::ThreadPool pool(2);
+    pool.parallel_for(paths.size(), [&](std::size_t i) {
+        auto reader = mimetrik::FacebowFileReader::open(paths[i]);
+        if (!reader)
+            errors[i] = reader.error();
+    });
+    EXPECT_FALSE(errors[0].has_value());
+    ASSERT_TRUE(errors[1].has_value());
+    EXPECT_EQ(errors[1]->code, mimetrik::MFBAOpenErrorCode::truncated);
+    EXPECT_EQ(errors[1]->first_bad_frame, std::optional<std::size_t>(2));
+    EXPECT_EQ(errors[1]->byte_offset, mimetrik::FacebowFileReader(VIDEO_PATH).get_frame_location_info()[2].frame_index);
+    EXPECT_EQ(errors[1]->num_frames, 3);
+    EXPECT_EQ(errors[1]->num_recoverable_frames, 2);
+    ASSERT_TRUE(errors[2].has_value());
+    EXPECT_EQ(errors[2]->code, mimetrik::MFBAOpenErrorCode::invalid_header);
+    EXPECT_FALSE(errors[2]->first_bad_frame.has_value());
+    ASSERT_TRUE(errors[3].has_value());
+    EXPECT_EQ(errors[3]->code, mimetrik::MFBAOpenErrorCode::io_error);
+
+    // In partial mode, the complete frames of the truncated file are readable as before:
+    auto salvaged = mimetrik::FacebowFileReader::open(TRUNCATED_PATH, mimetrik::MFBAOpenMode::partial);
+    ASSERT_TRUE(salvaged.has_value());
+    EXPECT_EQ(salvaged->get_image_count(), 2);
+    ASSERT_TRUE(salvaged->get_open_error().has_value());
+    EXPECT_EQ(salvaged->get_open_error()->to_string(), errors[1]->to_string());
+    const auto original = mimetrik::FacebowFileReader(VIDEO_PATH).get_image(1);
+    const auto image = salvaged->get_image(1);
+    ASSERT_EQ(image.rows, original.rows);
+    ASSERT_EQ(image.cols, original.cols);
+    EXPECT_EQ(std::memcmp(image.data, original.data, image.total() * image.elemSize()), 0);
+    EXPECT_THROW(salvaged->write_frame_index(mimetrik::get_frame_index_path(TRUNCATED_PATH)), std::runtime_error);
+    EXPECT_FALSE(std::filesystem::exists(mimetrik::get_frame_index_path(TRUNCATED_PATH)));
+    EXPECT_FALSE(mimetrik::FacebowFileReader::open(VIDEO_PATH, mimetrik::MFBAOpenMode::partial)->get_open_error().has_value());
+}
+
+TEST(MFBACatalogTest, GlobalIndexSpansFiles)
+{
+    const TestDirectory test_directory;
+    const std::filesystem::path DIRECTORY = test_directory.get_path();
+    write_test_mfba((DIRECTORY / "a.mfba").string(), 2);
+    write_test_mfba((DIRECTORY / "b.mfba").string(), 0); // Empty captures must not take up any global index
+    write_test_mfba((DIRECTORY / "c.mfba").string(), 1);
+
+    mimetrik::MFBACatalog::Options options;
+    options.max_open_files = 1;
+    mimetrik::MFBACatalog catalog(DIRECTORY, options);
+
+    EXPECT_EQ(catalog.get_file_count(), 3);
+    EXPECT_EQ(catalog.get_image_count(), 3);
+    EXPECT_EQ(catalog.locate(1), std::make_pair(std::size_t(0), std::size_t(1)));
+    EXPECT_EQ(catalog.locate(2), std::make_pair(std::size_t(2), std::size_t(0)));
+    EXPECT_THROW(catalog.locate(3), std::runtime_error);
+
+    // Frame 0 of c.mfba is global frame 2, and decoding it must work while only one file handle may be open at a time
+    const auto images = catalog.get_images({2, 1});
+    ASSERT_EQ(images.size(), 2);
+    EXPECT_EQ(images[0].at<cv::Vec3b>(0, 0)[1], test_pixel_value(0, 1));
+    EXPECT_EQ(images[1].at<cv::Vec3b>(0, 0)[1], test_pixel_value(1, 1));
+    EXPECT_LE(catalog.get_file_handle_cache().get_open_file_count(), 1u);
+
+    // The second read of a frame is served from the shared frame cache
+    EXPECT_EQ(catalog.get_image(2).data, images[0].data);
+}
+
+TEST(MFBACatalogTest, FailOnInvalidMemberFile)
+{
+    EXPECT_THROW(mimetrik::MFBACatalog({ std::filesystem::path("test_video_valid.mfba"), std::filesystem::path("test_video_invalid_signature.mfba") }), std::runtime_error);
+}
+
 int main(int argc, char** argv)
 {
     testing::InitGoogleTest(&argc, argv);
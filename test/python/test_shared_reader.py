@@ -0,0 +1,73 @@
+"""Checks that SharedFacebowFileReader survives pickling and fork, as in the workers of a PyTorch DataLoader.
+
+Run from the directory that contains the built FacebowFileReader module:
+    python -m unittest discover -s <repo>/test/python
+"""
+import multiprocessing
+import os
+import pickle
+import struct
+import tempfile
+import unittest
+
+import FacebowFileReader
+
+FRAME_BYTES = 1080 * 1920 * 3
+
+
+def write_test_mfba(path, num_frames):
+    """Write a synthetic MFBA 1.0.0 file, like write_test_mfba() in FacebowFileReaderTest.cpp."""
+    with open(path, "wb") as file:
+        file.write(bytes([0x46, 0x46, 0x46, 0x01, 0x00, 0x00]) + struct.pack(">H", num_frames))
+        for frame in range(num_frames):
+            metadata = ('[{"metadataSource":"Orientation","contents":[{"key":"Orientation","value":"6"}]},'
+                        '{"metadataSource":"CaptureResult","contents":[{"key":"android.sensor.timestamp","value":"'
+                        + str(1_000_000_000 + frame * 33_333_333) + '"}]}]').encode()
+            period = bytes(((frame * 31 + i) % 251) ^ 0xFF for i in range(251))
+            file.write(struct.pack(">III", 12, len(metadata), FRAME_BYTES))
+            file.write(bytes(c ^ 0xFF for c in metadata))
+            file.write((period * (FRAME_BYTES // 251 + 1))[:FRAME_BYTES])
+
+
+def read_in_worker(reader, index, queue):
+    queue.put(reader.get_image(index).tobytes())
+
+
+class SharedFacebowFileReaderTest(unittest.TestCase):
+
+    def setUp(self):
+        self.directory = tempfile.TemporaryDirectory()
+        self.path = os.path.join(self.directory.name, "shared.mfba")
+        write_test_mfba(self.path, 3)
+
+    def tearDown(self):
+        self.directory.cleanup()
+
+    def test_pickle_round_trip(self):
+        reader = FacebowFileReader.SharedFacebowFileReader(self.path)
+        self.assertTrue(os.path.exists(reader.get_index_path()))
+
+        copy = pickle.loads(pickle.dumps(reader))
+        self.assertEqual(len(copy), 3)
+        self.assertEqual(copy.get_index_path(), reader.get_index_path())
+        self.assertEqual(copy.get_timestamps(), reader.get_timestamps())
+        self.assertEqual(copy.get_image(2).tobytes(), reader.get_image(2).tobytes())
+
+    def test_fork_and_spawn_workers(self):
+        reader = FacebowFileReader.SharedFacebowFileReader(self.path)
+        expected = reader.get_image(1).tobytes()  # Opens the file in the parent before any worker starts
+        for method in ("fork", "spawn"):
+            if method not in multiprocessing.get_all_start_methods():
+                continue
+            with self.subTest(method=method):
+                context = multiprocessing.get_context(method)
+                queue = context.Queue()
+                worker = context.Process(target=read_in_worker, args=(reader, 1, queue))
+                worker.start()
+                self.assertEqual(queue.get(timeout=60), expected)
+                worker.join()
+                self.assertEqual(worker.exitcode, 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
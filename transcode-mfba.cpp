@@ -0,0 +1,59 @@
+#include <cstdlib>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include "mimetrik/MFBATranscoder.hpp"
+
+// Usage: transcode-mfba <input.mfba> <output.mfba> [1.0.0|1.1.0|1.2.0] [compression level]
+// Converts between raw (1.0.0), zstd-compressed (1.1.0) and hot, memory-mappable (1.2.0) MFBA files. The default target version is 1.1.0.
+int main(int argc, char* argv[])
+{
+	if (argc < 3 || argc > 5)
+	{
+		std::cerr << "Usage: " << argv[0] << " <input.mfba> <output.mfba> [1.0.0|1.1.0|1.2.0] [compression level]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	const std::string target = argc > 3 ? argv[3] : "1.1.0";
+	mimetrik::MFBAVersion target_version;
+	if (target == "1.0.0")
+		target_version = mimetrik::mfba_version_raw;
+	else if (target == "1.1.0")
+		target_version = mimetrik::mfba_version_compressed;
+	else if (target == "1.2.0")
+		target_version = mimetrik::mfba_version_hot;
+	else
+	{
+		std::cerr << "Unsupported target version: " << target << std::endl;
+		return EXIT_FAILURE;
+	}
+	int compression_level = 3;
+	try
+	{
+		if (argc > 4)
+			compression_level = std::stoi(argv[4]);
+	}
+	catch (const std::logic_error&) // std::invalid_argument or std::out_of_range
+	{
+		std::cerr << "Invalid compression level: " << argv[4] << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		if (target_version == mimetrik::mfba_version_hot)
+			mimetrik::repack_mfba_hot(argv[1], argv[2]);
+		else
+			mimetrik::transcode_mfba(argv[1], argv[2], target_version, compression_level);
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	std::cout << argv[1] << " (" << std::filesystem::file_size(argv[1]) << " bytes) -> " << argv[2] << " (" << std::filesystem::file_size(argv[2])
+	          << " bytes, MFBA " << target_version.to_string() << ")" << std::endl;
+	return EXIT_SUCCESS;
+}
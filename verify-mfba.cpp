@@ -0,0 +1,80 @@
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mimetrik/MFBAVerifier.hpp"
+#include "mimetrik/ThreadPool.hpp"
+
+// Usage: verify-mfba [--structure-only] [--write-sidecar] [--threads N] <file.mfba|directory> [...]
+// Verifies the frame table and per-frame CRC32C of every given MFBA file (directories are searched recursively for .mfba
+// files). Checksums are compared with the "<file>.crc32c.json" sidecar if one exists; --write-sidecar stores them there.
+// The exit code is non-zero if any file fails.
+int main(int argc, char* argv[])
+{
+	mimetrik::MFBAVerifyOptions options;
+	std::size_t num_threads = std::thread::hardware_concurrency();
+	std::vector<std::filesystem::path> files;
+	for (int i = 1; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--structure-only")
+			options.compute_checksums = false;
+		else if (arg == "--write-sidecar")
+			options.update_sidecar = true;
+		else if (arg == "--threads" && i + 1 < argc)
+			num_threads = std::stoul(argv[++i]);
+		else if (std::filesystem::is_directory(arg))
+		{
+			for (const auto& entry : std::filesystem::recursive_directory_iterator(arg))
+			{
+				if (entry.is_regular_file() && entry.path().extension() == ".mfba")
+					files.push_back(entry.path());
+			}
+		}
+		else
+			files.emplace_back(arg);
+	}
+	if (files.empty())
+	{
+		std::cerr << "Usage: " << argv[0] << " [--structure-only] [--write-sidecar] [--threads N] <file.mfba|directory> [...]" << std::endl;
+		return EXIT_FAILURE;
+	}
+	std::sort(files.begin(), files.end());
+
+	std::cout << "CRC32C: " << (mimetrik::crc32c_is_hardware_accelerated() ? "SSE4.2" : "software") << ", " << num_threads << " threads" << std::endl;
+
+	mimetrik::ThreadPool pool(num_threads);
+	std::size_t num_failed = 0;
+	for (const auto& file : files)
+	{
+		try
+		{
+			const auto report = mimetrik::verify_mfba(file, options, pool);
+			if (report.is_ok())
+			{
+				std::cout << "OK      " << file.string() << " (" << report.num_frames << " frames" << (report.sidecar_found ? ", matches sidecar" : "") << ")" << std::endl;
+				continue;
+			}
+			++num_failed;
+			std::cout << "FAILED  " << file.string() << std::endl;
+			if (report.structural_error)
+				std::cout << "        " << report.structural_error.value() << " (" << report.num_valid_frames << " of " << report.num_frames << " frames intact)" << std::endl;
+			if (report.sidecar_file_size_mismatch)
+				std::cout << "        file size differs from the " << report.sidecar_file_size_mismatch.value() << " bytes recorded in the sidecar" << std::endl;
+			for (const auto frame : report.checksum_mismatches)
+				std::cout << "        frame " << frame << ": checksum differs from sidecar" << std::endl;
+		}
+		catch (const std::exception& e)
+		{
+			++num_failed;
+			std::cout << "FAILED  " << file.string() << std::endl << "        " << e.what() << std::endl;
+		}
+	}
+
+	std::cout << files.size() - num_failed << " of " << files.size() << " files OK" << std::endl;
+	return num_failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}